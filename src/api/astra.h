@@ -0,0 +1,50 @@
+#ifndef ASTRA_H
+#define ASTRA_H
+
+/* c interface to the engine in libastra, for languages without c++ bindings */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct astra_engine astra_engine;
+
+typedef struct {
+    int depth;
+    int sel_depth;
+    int multipv;
+    int mate;  /* score is in moves to mate when set, else in centipawns */
+    int score;
+    uint64_t nodes;
+    uint64_t nps;
+    int hashfull;
+    int64_t time_ms;
+    const char* pv; /* moves separated by spaces, only valid during the callback */
+} astra_info;
+
+/* called on the search threads, ponder is an empty string when there is none */
+typedef void (*astra_info_cb)(const astra_info* info, void* user);
+typedef void (*astra_bestmove_cb)(const char* best, const char* ponder, void* user);
+
+astra_engine* astra_new(int threads, uint64_t hash_mb);
+void astra_free(astra_engine* engine);
+
+void astra_set_callbacks(astra_engine* engine, astra_info_cb on_info, astra_bestmove_cb on_bestmove, void* user);
+void astra_new_game(astra_engine* engine);
+
+/* moves may be null or a space separated list in uci notation, returns 0 if fen is null or
+   invalid or a move is illegal */
+int astra_set_position(astra_engine* engine, const char* fen, const char* moves);
+
+/* limits that are 0 are not used, returns right away */
+void astra_go(astra_engine* engine, int depth, uint64_t nodes, int64_t movetime_ms);
+void astra_stop(astra_engine* engine);
+void astra_wait(astra_engine* engine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <format>
+#include <sstream>
+
+#include "astra.h"
+#include "engine.h"
+
+struct astra_engine {
+    astra::Engine engine;
+
+    astra_engine(int threads, uint64_t hash_mb)
+        : engine(threads, hash_mb) {}
+};
+
+extern "C" {
+
+astra_engine* astra_new(int threads, uint64_t hash_mb) { return new astra_engine(threads, hash_mb); }
+
+void astra_free(astra_engine* engine) { delete engine; }
+
+void astra_set_callbacks(astra_engine* engine, astra_info_cb on_info, astra_bestmove_cb on_bestmove, void* user) {
+    if (on_info) {
+        engine->engine.on_info([on_info, user](const astra::search::SearchInfo& info) {
+            std::string pv;
+            for (auto move : info.pv) {
+                if (!pv.empty())
+                    pv += ' ';
+                pv += std::format("{}", move);
+            }
+
+            const astra_info c_info{
+                info.depth,
+                info.sel_depth,
+                info.multipv,
+                info.mate,
+                info.score,
+                info.nodes,
+                info.nps,
+                info.hashfull,
+                info.time_ms,
+                pv.c_str(),
+            };
+            on_info(&c_info, user);
+        });
+    } else {
+        engine->engine.on_info(nullptr);
+    }
+
+    if (on_bestmove) {
+        engine->engine.on_bestmove([on_bestmove, user](astra::Move best, astra::Move ponder) {
+            const std::string best_str = std::format("{}", best);
+            const std::string ponder_str = ponder ? std::format("{}", ponder) : "";
+            on_bestmove(best_str.c_str(), ponder_str.c_str(), user);
+        });
+    } else {
+        engine->engine.on_bestmove(nullptr);
+    }
+}
+
+void astra_new_game(astra_engine* engine) { engine->engine.new_game(); }
+
+int astra_set_position(astra_engine* engine, const char* fen, const char* moves) {
+    if (!fen)
+        return 0;
+
+    std::vector<std::string> move_list;
+    if (moves) {
+        std::istringstream is(moves);
+        for (std::string move; is >> move;)
+            move_list.push_back(move);
+    }
+
+    return engine->engine.set_position(fen, move_list);
+}
+
+void astra_go(astra_engine* engine, int depth, uint64_t nodes, int64_t movetime_ms) {
+    astra::search::Limits limits;
+    if (depth > 0)
+        limits.depth = std::min(depth, astra::search::MAX_PLY - 1);
+    limits.nodes = nodes;
+    limits.time.maximum = movetime_ms;
+
+    engine->engine.go(limits);
+}
+
+void astra_stop(astra_engine* engine) { engine->engine.stop(); }
+
+void astra_wait(astra_engine* engine) { engine->engine.wait(); }
+}
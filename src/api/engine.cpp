@@ -0,0 +1,103 @@
+#include <mutex>
+
+#include "../chess/bitboard.h"
+#include "../chess/cuckoo.h"
+#include "../chess/zobrist.h"
+#include "../nnue/nnue.h"
+#include "../uci/uci.h"
+#include "engine.h"
+
+namespace astra {
+
+namespace {
+
+// what main does before the uci loop starts, once per process
+void init_tables() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        bitboards::init();
+        zobrist::init();
+        cuckoo::init();
+        nnue::nnue.init();
+    });
+}
+
+} // namespace
+
+Engine::Engine(int threads, uint64_t hash_mb) {
+    init_tables();
+
+    tt_ = std::make_unique<search::TTable>(hash_mb);
+    tt_->wait_cleared();
+
+    pool_ = std::make_unique<search::ThreadPool>(tt_.get());
+    tt_->set_pool(pool_.get());
+
+    // a handler has to be set, otherwise bestmove would be printed
+    pool_->set_bestmove_handler([](Move, Move) {});
+    pool_->set_count(threads);
+
+    board_.set_fen(uci::STARTING_FEN);
+}
+
+Engine::~Engine() {
+    stop();
+    pool_.reset();
+}
+
+void Engine::set_threads(int threads) { pool_->set_count(threads); }
+
+void Engine::set_hash(uint64_t hash_mb) {
+    stop();
+    tt_->init(hash_mb);
+}
+
+void Engine::new_game() {
+    stop();
+    pool_->new_game();
+    pool_->wait_cleared();
+    tt_->wait_cleared();
+}
+
+bool Engine::set_position(const std::string& fen, const std::vector<std::string>& moves) {
+    if (!uci::valid_fen(fen))
+        return false;
+
+    Board board(fen);
+
+    for (const auto& str : moves) {
+        const Move move = uci::parse_move(board, str);
+        if (!move)
+            return false;
+
+        board.make_move(move);
+        if (!board.fifty_move_count())
+            board.reset_ply();
+    }
+
+    board_ = board;
+    return true;
+}
+
+void Engine::on_info(search::ThreadPool::InfoHandler handler) {
+    wait();
+    pool_->set_info_handler(std::move(handler));
+}
+
+void Engine::on_bestmove(search::ThreadPool::BestmoveHandler handler) {
+    wait();
+    if (!handler)
+        handler = [](Move, Move) {};
+    pool_->set_bestmove_handler(std::move(handler));
+}
+
+void Engine::go(const search::Limits& limits) { pool_->launch_workers(board_, limits); }
+
+void Engine::stop() {
+    pool_->stop();
+    pool_->wait();
+}
+
+void Engine::wait() { pool_->wait(); }
+
+} // namespace astra
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../search/threads.h"
+
+namespace astra {
+
+// an engine for programs linking libastra instead of talking uci over a pipe. every
+// engine has its own threads and hash table, results arrive through the handlers on
+// the search threads, so they must not block for long
+class Engine {
+  public:
+    explicit Engine(int threads = 1, uint64_t hash_mb = 16);
+    ~Engine();
+
+    Engine(const Engine&) = delete;
+    Engine& operator=(const Engine&) = delete;
+
+    void set_threads(int threads);
+    void set_hash(uint64_t hash_mb);
+    void new_game();
+
+    // moves are in uci notation, returns false and keeps the old position if the fen is
+    // invalid or a move is illegal
+    bool set_position(const std::string& fen, const std::vector<std::string>& moves = {});
+    const Board& board() const { return board_; }
+
+    void on_info(search::ThreadPool::InfoHandler handler);
+    void on_bestmove(search::ThreadPool::BestmoveHandler handler);
+
+    // returns right away, the bestmove handler is called once the search ends
+    void go(const search::Limits& limits);
+    void stop();
+    void wait();
+
+  private:
+    std::unique_ptr<search::TTable> tt_;
+    std::unique_ptr<search::ThreadPool> pool_;
+    Board board_;
+};
+
+} // namespace astra
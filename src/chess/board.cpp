@@ -249,6 +249,45 @@ nnue::DirtyPieceList Board::make_move(Move move) {
     return dirty_pieces;
 }
 
+// hash of the position after the move, computed without making it
+Hash Board::key_after(Move move) const {
+    const Square from = move.from();
+    const Square to = move.to();
+    const Piece pc = piece_at(from);
+    const StateInfo& info = state();
+
+    assert(move);
+    assert(is_valid(pc));
+
+    Hash key = info.hash ^ zobrist::side();
+
+    if (is_valid(info.ep_sq))
+        key ^= zobrist::ep_sq(info.ep_sq);
+
+    if (move.is_castling()) {
+        auto [rook_from, rook_to] = castling_rook_sqs(stm_, to);
+        key ^= zobrist::psq(make_piece(stm_, ROOK), rook_from) ^ zobrist::psq(make_piece(stm_, ROOK), rook_to);
+    }
+
+    if (move.is_cap())
+        key ^= zobrist::psq(capture_piece(move), move.is_ep() ? ep_sq(to) : to);
+
+    const Piece to_pc = move.is_prom() ? make_piece(stm_, move.prom_type()) : pc;
+    key ^= zobrist::psq(pc, from) ^ zobrist::psq(to_pc, to);
+
+    if (type_of(pc) == PAWN && (from ^ to) == 16) {
+        Square new_ep_sq = ep_sq(to);
+        if (pawn_attacks_bb(stm_, new_ep_sq) & piece_bb<PAWN>(~stm_))
+            key ^= zobrist::ep_sq(new_ep_sq);
+    }
+
+    CastlingRights castling_rights = info.castling_rights;
+    if (castling_rights.on_castling_sq(from) || castling_rights.on_castling_sq(to))
+        key ^= castling_rights.update(from, to);
+
+    return key;
+}
+
 void Board::undo_move(Move move) {
     const Square from = move.from();
     const Square to = move.to();
@@ -387,7 +426,8 @@ bool Board::is_pseudo_legal(Move move) const {
     }
 
     if (move.is_ep())
-        if (pt != PAWN || info.ep_sq != to || is_valid(to_pc) || captured != make_piece(~stm_, PAWN))
+        if (pt != PAWN || info.ep_sq != to || is_valid(to_pc) || captured != make_piece(~stm_, PAWN)
+            || !(pawn_attacks_bb(stm_, from) & sq_bb(to)))
             return false;
 
     if (move.is_prom()) {
@@ -56,6 +56,7 @@ class Board {
     Bitboard check_squares(PieceType pt) const;
 
     Hash hash() const;
+    Hash key_after(Move move) const;
     Hash pawn_hash() const;
     Hash minor_piece_hash() const;
     Hash non_pawn_hash(Color c) const;
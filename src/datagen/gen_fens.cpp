@@ -16,7 +16,7 @@ namespace astra::datagen {
 
 search::Score evaluate_board(const std::string& fen, const search::Limits& limit) {
     Board board{fen};
-    search::thread_pool.new_game();
+    search::thread_pool.new_game(false);
     search::thread_pool.launch_workers(board, limit);
     search::thread_pool.wait();
     return search::thread_pool.main_thread()->best_root_move().score;
@@ -63,6 +63,19 @@ void AccumulatorEntry::reset() {
     nnue.init_accum(accum);
 }
 
+// the accumulator is updated lazily on the next evaluation, so start loading the
+// first line of each weight row now and let the hardware prefetcher follow
+void AccumulatorList::prefetch_weights(const Accumulator& accum) const {
+    for (Color view : {WHITE, BLACK}) {
+        for (const auto& dp : accum.dirty_pieces) {
+            if (is_valid(dp.from))
+                __builtin_prefetch(nnue.feature_weight(dp.pc, dp.from, accum.king_sq(view), view));
+            if (is_valid(dp.to))
+                __builtin_prefetch(nnue.feature_weight(dp.pc, dp.to, accum.king_sq(view), view));
+        }
+    }
+}
+
 void AccumulatorList::refresh(Color view, Board& board) {
     assert(is_valid(view));
 
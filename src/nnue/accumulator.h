@@ -154,6 +154,8 @@ class AccumulatorList {
         data_(idx_).dirty_pieces = dirty_pieces;
         data_(idx_).king_sq(WHITE) = w_ksq;
         data_(idx_).king_sq(BLACK) = b_ksq;
+
+        prefetch_weights(data_(idx_));
     }
 
     void pop() {
@@ -179,6 +181,8 @@ class AccumulatorList {
     int idx_;
     NDArray<Accumulator, MAX_SIZE> data_;
     NDArray<AccumulatorEntry, NUM_COLORS, 2 * INPUT_BUCKETS> entries_;
+
+    void prefetch_weights(const Accumulator& accum) const;
 };
 
 } // namespace astra::nnue
@@ -0,0 +1,166 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "output.h"
+
+namespace astra {
+
+namespace {
+
+// stdout is only touched by one thread, which collects the queued lines and writes
+// them in batches. searching threads never wait on a slow pipe, unless the queue is full
+class OutputWriter {
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t CAPACITY = 4096;
+    static constexpr size_t BATCH_BYTES = 64 * 1024;
+    static constexpr auto BATCH_TIME = std::chrono::milliseconds(5);
+
+  public:
+    OutputWriter()
+        : cells_(std::make_unique<Cell[]>(CAPACITY)) {
+        for (size_t i = 0; i < CAPACITY; i++)
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+
+        thread_ = std::thread([this] { run(); });
+    }
+
+    ~OutputWriter() {
+        exiting_.store(true, std::memory_order_release);
+        queued_.fetch_add(1, std::memory_order_release);
+        queued_.notify_one();
+        thread_.join();
+    }
+
+    // bounded multi producer queue, every cell carries a sequence number telling whether
+    // it is free for the producer at that position or filled for the consumer
+    void push(const std::string& line) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        Cell* cell;
+
+        while (true) {
+            cell = &cells_[pos & (CAPACITY - 1)];
+            const size_t seq = cell->seq.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                // full, lines are never dropped, so wait for the writer to catch up
+                std::this_thread::yield();
+                pos = head_.load(std::memory_order_relaxed);
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+
+        // cells keep their capacity, so this rarely allocates
+        cell->line.assign(line);
+        cell->seq.store(pos + 1, std::memory_order_release);
+
+        queued_.fetch_add(1, std::memory_order_release);
+        queued_.notify_one();
+    }
+
+  private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        std::string line;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) size_t tail_ = 0; // only used by the writer
+
+    std::atomic<uint64_t> queued_{0};
+    std::atomic<bool> exiting_{false};
+
+    std::thread thread_;
+    std::string batch_;
+
+    bool pop(bool& urgent) {
+        Cell& cell = cells_[tail_ & (CAPACITY - 1)];
+        if (cell.seq.load(std::memory_order_acquire) != tail_ + 1)
+            return false;
+
+        batch_ += cell.line;
+        // the gui waits on these, so they are written without waiting for more lines
+        urgent = cell.line.starts_with("bestmove") || cell.line.starts_with("readyok")
+                 || cell.line.starts_with("uciok");
+
+        cell.seq.store(tail_ + CAPACITY, std::memory_order_release);
+        tail_++;
+        return true;
+    }
+
+    void write_batch() {
+        if (batch_.empty())
+            return;
+
+        std::fwrite(batch_.data(), 1, batch_.size(), stdout);
+        std::fflush(stdout);
+        batch_.clear();
+    }
+
+    void run() {
+        while (true) {
+            const uint64_t seen = queued_.load(std::memory_order_acquire);
+            const bool exiting = exiting_.load(std::memory_order_acquire);
+            auto batch_start = Clock::now();
+
+            bool urgent = false;
+            while (pop(urgent)) {
+                if (urgent || batch_.size() >= BATCH_BYTES || Clock::now() - batch_start >= BATCH_TIME) {
+                    write_batch();
+                    batch_start = Clock::now();
+                }
+            }
+
+            write_batch();
+
+            if (exiting)
+                break;
+
+            queued_.wait(seen, std::memory_order_acquire);
+        }
+    }
+};
+
+std::atomic<OutputWriter*> writer{nullptr};
+std::atomic<bool> stopped{false};
+std::once_flag started;
+
+// the thread is only started once something is printed, so programs linking libastra
+// without printing never get it. at exit the remaining lines are written before the join
+struct WriterShutdown {
+    ~WriterShutdown() {
+        stopped.store(true, std::memory_order_release);
+        delete writer.exchange(nullptr, std::memory_order_acq_rel);
+    }
+} writer_shutdown;
+
+OutputWriter* get_writer() {
+    if (stopped.load(std::memory_order_acquire))
+        return nullptr;
+
+    std::call_once(started, [] { writer.store(new OutputWriter, std::memory_order_release); });
+    return writer.load(std::memory_order_acquire);
+}
+
+} // namespace
+
+void write_line(const std::string& line) {
+    if (OutputWriter* w = get_writer()) {
+        w->push(line);
+    } else {
+        std::fwrite(line.data(), 1, line.size(), stdout);
+        std::fflush(stdout);
+    }
+}
+
+} // namespace astra
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+
+namespace astra {
+
+// hands a complete line to the output thread, which writes it to stdout in order with
+// the others. lines printed after the thread has been shut down at exit are written directly
+void write_line(const std::string& line);
+
+} // namespace astra
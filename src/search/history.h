@@ -1,11 +1,13 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 
 #include "../chess/board.h"
 #include "../chess/movegen.h"
 #include "../ndarray.h"
+#include "../util.h"
 #include "tune_params.h"
 #include "types.h"
 
@@ -18,6 +20,19 @@ void apply_bonus(int16_t& v, int bonus) {
     v += bonus - v * std::abs(bonus) / Div;
 }
 
+// for tables that other threads may update at the same time. a lost update is fine,
+// a torn one can't happen, and on x86 this is the same plain load and store as above
+template <int Div>
+void apply_bonus_relaxed(int16_t& v, int bonus) {
+    std::atomic_ref<int16_t> ref(v);
+    const int16_t old = ref.load(std::memory_order_relaxed);
+    ref.store(old + bonus - old * std::abs(bonus) / Div, std::memory_order_relaxed);
+}
+
+inline int16_t load_relaxed(const int16_t& v) {
+    return std::atomic_ref<int16_t>(const_cast<int16_t&>(v)).load(std::memory_order_relaxed);
+}
+
 } // namespace
 
 class QuietHistory {
@@ -96,7 +111,7 @@ class PawnHistory {
         Piece pc = board.piece_at(move.from());
         assert(is_valid(pc));
 
-        apply_bonus<BONUS_DIV>(data_(idx(board.pawn_hash()), pc, move.to()), bonus);
+        apply_bonus_relaxed<BONUS_DIV>(data_(idx(board.pawn_hash()), pc, move.to()), bonus);
     }
 
     int get(const Board& board, Move move) const {
@@ -105,7 +120,7 @@ class PawnHistory {
         Piece pc = board.piece_at(move.from());
         assert(is_valid(pc));
 
-        return data_(idx(board.pawn_hash()), pc, move.to());
+        return load_relaxed(data_(idx(board.pawn_hash()), pc, move.to()));
     }
 
   private:
@@ -155,7 +170,7 @@ class CorrectionHistories {
     void update(const Board& board, int bonus) {
         int i = 0;
         for (auto hash : hashes(board))
-            apply_bonus<BONUS_DIV>(data_(i++, board.side_to_move(), idx(hash)), bonus);
+            apply_bonus_relaxed<BONUS_DIV>(data_(i++, board.side_to_move(), idx(hash)), bonus);
     }
 
     int get(const Board& board) const {
@@ -163,7 +178,7 @@ class CorrectionHistories {
 
         int i = 0, value = 0;
         for (auto weight : {p_corr_weight, m_corr_weight, np_corr_weight, np_corr_weight}) {
-            value += weight * data_(i, board.side_to_move(), idx(hashes(i)));
+            value += weight * load_relaxed(data_(i, board.side_to_move(), idx(hashes(i))));
             ++i;
         }
 
@@ -227,4 +242,18 @@ class ContinuationCorrectionHistory {
     NDArray<PieceToContinuation, NUM_PIECES + 1, NUM_SQUARES> data_;
 };
 
+// the big tables keyed by position, threads on the same node can share them with ShareHistory
+struct NodeHistories {
+    PawnHistory pawn;
+    CorrectionHistories corr;
+
+    void clear() {
+        pawn.clear();
+        corr.clear();
+    }
+
+    static void* operator new(size_t size) { return alloc_align(size); }
+    static void operator delete(void* ptr) { free_align(ptr); }
+};
+
 } // namespace astra::search
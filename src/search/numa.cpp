@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "../util.h"
+#include "numa.h"
+
+namespace astra::numa {
+
+namespace {
+
+#if defined(__linux__)
+constexpr int MPOL_PREFERRED = 1;
+constexpr int MPOL_INTERLEAVE = 3;
+constexpr int MAX_NODES = 1024;
+constexpr int BITS_PER_WORD = 8 * sizeof(unsigned long);
+#endif
+
+// parses lists like "0-3,8-11"
+std::vector<int> parse_list(const std::string& str) {
+    std::vector<int> list;
+    for (const auto& range : split(str, ',')) {
+        const size_t dash = range.find('-');
+        const int first = std::stoi(range.substr(0, dash));
+        const int last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+        for (int i = first; i <= last; ++i)
+            list.push_back(i);
+    }
+    return list;
+}
+
+std::string read_line(const std::string& path) {
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+std::vector<Node> discover() {
+    std::vector<Node> result;
+
+#if defined(__linux__)
+    const std::string online = read_line("/sys/devices/system/node/online");
+    if (!online.empty()) {
+        for (int id : parse_list(online)) {
+            const std::string cpus = read_line("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+            if (cpus.empty())
+                continue; // memory-only node
+            result.push_back({id, parse_list(cpus)});
+        }
+    }
+#endif
+
+    if (result.empty()) {
+        Node node;
+        const int cpu_count = std::max(1u, std::thread::hardware_concurrency());
+        for (int i = 0; i < cpu_count; ++i)
+            node.cpus.push_back(i);
+        result.push_back(node);
+    }
+
+    return result;
+}
+
+std::vector<Cpu> discover_cpus() {
+    std::vector<Cpu> result;
+
+    std::map<int, int> node_of;
+    for (const auto& node : nodes())
+        for (int cpu : node.cpus)
+            node_of[cpu] = node.id;
+
+    std::map<std::pair<int, int>, int> core_ids;
+
+    for (const auto& [id, node] : node_of) {
+        Cpu cpu;
+        cpu.id = id;
+        cpu.node = node;
+
+#if defined(__linux__)
+        const std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(id) + "/topology/";
+        const std::string package = read_line(topology + "physical_package_id");
+        const std::string core = read_line(topology + "core_id");
+        const std::string siblings = read_line(topology + "thread_siblings_list");
+
+        if (!package.empty() && !core.empty()) {
+            const auto key = std::make_pair(std::stoi(package), std::stoi(core));
+            const auto it = core_ids.try_emplace(key, core_ids.size()).first;
+            cpu.core = it->second;
+        } else {
+            cpu.core = core_ids.emplace(std::make_pair(-1, id), core_ids.size()).first->second;
+        }
+
+        if (!siblings.empty()) {
+            const auto list = parse_list(siblings);
+            cpu.sibling = std::find(list.begin(), list.end(), id) - list.begin();
+        }
+#else
+        cpu.core = id;
+#endif
+
+        result.push_back(cpu);
+    }
+
+    return result;
+}
+
+#if defined(__linux__)
+void set_policy(void* ptr, size_t size, int mode, const std::vector<int>& node_ids) {
+    unsigned long mask[MAX_NODES / BITS_PER_WORD] = {};
+    for (int id : node_ids)
+        if (id < MAX_NODES)
+            mask[id / BITS_PER_WORD] |= 1UL << (id % BITS_PER_WORD);
+
+    syscall(SYS_mbind, ptr, size, mode, mask, MAX_NODES, 0);
+}
+#endif
+
+} // namespace
+
+const std::vector<Node>& nodes() {
+    static const std::vector<Node> nodes = discover();
+    return nodes;
+}
+
+const std::vector<Cpu>& cpus() {
+    static const std::vector<Cpu> cpus = discover_cpus();
+    return cpus;
+}
+
+std::vector<int> placement(BindingPolicy policy) {
+    if (policy == BindingPolicy::NONE)
+        return {};
+
+    // per node, first the first hyperthread of every core, then the second ones...
+    std::vector<std::vector<int>> node_cpus;
+    std::vector<int> node_cores;
+
+    for (const auto& node : nodes()) {
+        std::vector<Cpu> list;
+        for (const auto& cpu : cpus())
+            if (cpu.node == node.id)
+                list.push_back(cpu);
+
+        std::stable_sort(list.begin(), list.end(), [](const Cpu& a, const Cpu& b) { return a.sibling < b.sibling; });
+
+        std::vector<int> ids;
+        for (const auto& cpu : list)
+            ids.push_back(cpu.id);
+
+        node_cores.push_back(std::count_if(list.begin(), list.end(), [](const Cpu& c) { return c.sibling == 0; }));
+        node_cpus.push_back(ids);
+    }
+
+    std::vector<int> order;
+
+    if (policy == BindingPolicy::COMPACT) {
+        for (const auto& ids : node_cpus)
+            order.insert(order.end(), ids.begin(), ids.end());
+        return order;
+    }
+
+    // scatter, always continue on the node with the lowest share of used cpus
+    std::vector<size_t> used(node_cpus.size(), 0);
+    for (size_t n = 0; n < cpus().size(); ++n) {
+        int best = -1;
+        for (size_t i = 0; i < node_cpus.size(); ++i) {
+            if (used[i] == node_cpus[i].size())
+                continue;
+            if (best < 0 || used[i] * node_cores[best] < used[best] * node_cores[i])
+                best = i;
+        }
+
+        if (best < 0)
+            break;
+        order.push_back(node_cpus[best][used[best]++]);
+    }
+
+    return order;
+}
+
+BindingPolicy binding_policy_from_str(const std::string& str) {
+    const std::string policy = to_lower(str);
+    if (policy == "compact")
+        return BindingPolicy::COMPACT;
+    if (policy == "scatter")
+        return BindingPolicy::SCATTER;
+    if (policy != "none")
+        println("info string Unknown ThreadBinding {}, using none", str);
+    return BindingPolicy::NONE;
+}
+
+bool bind_thread(const Node& node) { return bind_cpus(node.cpus); }
+
+bool bind_cpus(const std::vector<int>& cpus) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set) == 0;
+#else
+    (void) cpus;
+    return false;
+#endif
+}
+
+std::vector<int> thread_cpus() {
+    std::vector<int> result;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &set) == 0)
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            if (CPU_ISSET(cpu, &set))
+                result.push_back(cpu);
+#endif
+    return result;
+}
+
+void interleave_memory(void* ptr, size_t size) {
+#if defined(__linux__)
+    if (nodes().size() < 2)
+        return;
+
+    std::vector<int> node_ids;
+    for (const auto& node : nodes())
+        node_ids.push_back(node.id);
+    set_policy(ptr, size, MPOL_INTERLEAVE, node_ids);
+#else
+    (void) ptr;
+    (void) size;
+#endif
+}
+
+void prefer_memory(void* ptr, size_t size, const Node& node) {
+#if defined(__linux__)
+    if (nodes().size() < 2)
+        return;
+    set_policy(ptr, size, MPOL_PREFERRED, {node.id});
+#else
+    (void) ptr;
+    (void) size;
+    (void) node;
+#endif
+}
+
+std::string cpu_list_str(const std::vector<int>& cpus) {
+    std::string str;
+    for (size_t i = 0; i < cpus.size(); ++i) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+            ++j;
+
+        if (!str.empty())
+            str += ',';
+        str += (i == j) ? std::to_string(cpus[i]) : std::format("{}-{}", cpus[i], cpus[j]);
+        i = j;
+    }
+    return str;
+}
+
+} // namespace astra::numa
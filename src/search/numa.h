@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace astra::numa {
+
+struct Node {
+    int id = 0;
+    std::vector<int> cpus;
+};
+
+struct Cpu {
+    int id = 0;
+    int node = 0;
+    int core = 0;    // unique across packages
+    int sibling = 0; // index among the hyperthreads of its core
+};
+
+enum class BindingPolicy : uint8_t { NONE, COMPACT, SCATTER };
+
+// nodes are read once from /sys, falls back to a single node holding every cpu
+const std::vector<Node>& nodes();
+const std::vector<Cpu>& cpus();
+
+// cpus in the order threads should be placed on them. physical cores always come
+// before their hyperthreads, compact fills one node after another while scatter
+// spreads threads over the nodes in proportion to their core counts
+std::vector<int> placement(BindingPolicy policy);
+BindingPolicy binding_policy_from_str(const std::string& str);
+
+bool bind_thread(const Node& node);
+bool bind_cpus(const std::vector<int>& cpus);
+std::vector<int> thread_cpus();
+
+// memory policies only affect pages that haven't been touched yet
+void interleave_memory(void* ptr, size_t size);
+void prefer_memory(void* ptr, size_t size, const Node& node);
+
+std::string cpu_list_str(const std::vector<int>& cpus);
+
+} // namespace astra::numa
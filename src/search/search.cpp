@@ -31,39 +31,107 @@ void update_pv(Move move, Stack* stack) {
         stack->pv(i) = (stack + 1)->pv(i);
 }
 
+constexpr double max_load_extension = 2.0;
+
+// a thread that finds another one of its pool already below a move near the root reduces
+// it a bit more and spends its time elsewhere
+constexpr int breadcrumb_max_ply = 8;
+
+class BreadcrumbMark {
+  public:
+    BreadcrumbMark(ThreadPool* pool, const Search* owner, Hash key, bool enabled) {
+        if (!enabled)
+            return;
+
+        Breadcrumb& crumb = pool->breadcrumb(key);
+        const Search* current = nullptr;
+
+        if (crumb.owner.compare_exchange_strong(current, owner, std::memory_order_relaxed)) {
+            crumb.key.store(key, std::memory_order_relaxed);
+            crumb_ = &crumb;
+        } else if (current != owner && crumb.key.load(std::memory_order_relaxed) == key) {
+            busy_ = true;
+        }
+    }
+
+    ~BreadcrumbMark() {
+        if (crumb_)
+            crumb_->owner.store(nullptr, std::memory_order_relaxed);
+    }
+
+    BreadcrumbMark(const BreadcrumbMark&) = delete;
+    BreadcrumbMark& operator=(const BreadcrumbMark&) = delete;
+
+    bool busy() const { return busy_; }
+
+  private:
+    Breadcrumb* crumb_ = nullptr;
+    bool busy_ = false;
+};
+
 } // namespace
 
 void Search::idle() {
-    thread_pool.add_started_thread();
+    uint64_t epoch = pool_->epoch();
+    pool_->add_started_thread();
 
     while (!exiting) {
+        // with SpinWait the next launch is picked up without a wakeup through the kernel
+        pool_->spin_wait(epoch);
+
         std::unique_lock lock(mutex);
         cv.wait(lock, [&] { return searching; });
 
         if (exiting)
             return;
 
-        start();
+        if (job) {
+            job();
+            job = nullptr;
+        } else {
+            start();
+        }
+
         searching = false;
 
+        // read while still holding the lock, so the next launch can't have happened yet
+        epoch = pool_->epoch();
+
         cv.notify_all();
     }
 }
 
+// shared node histories are cleared by the thread pool
 void Search::clear_histories() {
+    if (own_histories_)
+        own_histories_->clear();
+
     quiet_history_.clear();
     noisy_history_.clear();
-    pawn_history_.clear();
     cont_history_.clear();
-    corr_histories_.clear();
     cont_corr_history_.clear();
 }
 
+// shared node histories are only copied when asked to, they might already be in use
+void Search::copy_histories(const Search& other, bool node_histories) {
+    quiet_history_ = other.quiet_history_;
+    noisy_history_ = other.noisy_history_;
+    cont_history_ = other.cont_history_;
+    cont_corr_history_ = other.cont_corr_history_;
+
+    if (node_histories) {
+        pawn_history_ = other.pawn_history_;
+        corr_histories_ = other.corr_histories_;
+    }
+}
+
 void Search::start() {
     tm_.start();
 
-    nodes_ = 0;
-    tb_hits_ = 0;
+    // bounds the overshoot of a node limit to about 0.1% per thread
+    next_limit_check_ = 0;
+    const uint64_t node_limit = limits.nodes ? limits.nodes : (limits.nodes_time ? limits.time.maximum : 0);
+    limit_check_interval_ = node_limit ? std::clamp<uint64_t>(node_limit / 1024, 1, 1024) : 1024;
     nmp_min_ply_ = 0;
     completed_depth_ = 0;
     root_moves_.clear();
@@ -84,10 +152,10 @@ void Search::start() {
     limits.multipv = std::min(limits.multipv, root_moves_.size());
     accum_list_.reset(board);
 
-    const bool is_main_thread = (this == thread_pool.main_thread());
+    const bool is_main_thread = (this == pool_->main_thread());
 
-    if (is_main_thread)
-        tt.increment();
+    if (is_main_thread && !limits.keep_tt_age)
+        tt_->increment();
 
     NDArray<Stack, MAX_PLY + 6> stack_arr; // +6 for continuation history
     Stack* stack = stack_arr.data() + 6;
@@ -105,21 +173,29 @@ void Search::start() {
         for (multipv_idx_ = 0; multipv_idx_ < limits.multipv; ++multipv_idx_)
             aspiration(root_depth_, stack);
 
-        if (thread_pool.is_stopped())
+        if (pool_->is_stopped())
             break;
 
         completed_depth_ = root_depth_;
 
-        if (is_main_thread && !limits.minimal)
+        if (is_main_thread)
+            pool_->set_completed_move(root_moves_[0]);
+
+        if (is_main_thread && !limits.minimal) {
             for (multipv_idx_ = 0; multipv_idx_ < limits.multipv; ++multipv_idx_)
                 print_uci_info();
 
+            if (limits.tt_stats)
+                pool_->tt_stats().print(tt_->hashfull());
+        }
+
         Move best_move = root_moves_[0];
         Score score = root_moves_[0].score;
 
         stability = (best_move == prev_best_move) ? std::min<int>(stability + 1, tm_stability_max) : 0;
 
-        if (is_main_thread && root_depth_ >= 5 && limits.time.optimum) {
+        // soft limits are checked against the time since go, so time spent pondering counts too
+        if (is_main_thread && root_depth_ >= 5 && limits.time.optimum && !pool_->pondering()) {
             double stability_factor = (tm_stability_base / 100.0) - stability * (tm_stability_mult / 1000.0);
 
             double result_change_factor = (tm_results_base / 100.0)                                         //
@@ -131,8 +207,11 @@ void Search::start() {
             double node_ratio = root_moves_[0].nodes / static_cast<double>(nodes_);
             double node_count_factor = (1.0 - node_ratio) * (tm_node_mult / 100.0) + (tm_node_base / 100.0);
 
+            // a starved machine gets more soft time, the watchdog still stops us at the hard limit
+            double load = (limits.load_aware && !limits.nodes_time) ? load_factor() : 1.0;
+
             // check if we should stop
-            if (tm_.elapsed_time() > limits.time.optimum * stability_factor * result_change_factor * node_count_factor)
+            if (elapsed() > limits.time.optimum * stability_factor * result_change_factor * node_count_factor * load)
                 break;
         }
 
@@ -143,13 +222,24 @@ void Search::start() {
     if (!is_main_thread)
         return;
 
-    thread_pool.stop();
-    thread_pool.wait(false);
+    // a search that ends on its own while pondering still has to wait for ponderhit or stop
+    pool_->wait_ponder();
+
+    pool_->stop();
+    pool_->wait(false);
+
+    // only an unloaded search tells us what this machine can do
+    if (const int64_t wall = tm_.elapsed_time(); wall >= 200 && tm_.elapsed_cpu_time() >= wall * 9 / 10)
+        pool_->record_nps(pool_->total_nodes() * 1000 / wall);
 
     multipv_idx_ = 0;
 
+    // the watchdog already answered for us
+    if (pool_->bestmove_sent())
+        return;
+
     Move best_move = root_moves_[0];
-    Search* best_thread = thread_pool.pick_best();
+    Search* best_thread = pool_->pick_best();
     if (best_thread != this) {
         best_thread->multipv_idx_ = 0;
         best_thread->print_uci_info();
@@ -158,7 +248,23 @@ void Search::start() {
         print_uci_info();
     }
 
-    println("bestmove {}", best_move);
+    pool_->send_bestmove(best_move, ponder_move(best_thread->root_moves_[0]));
+}
+
+// the expected reply comes from the pv, or from the tt if the pv was cut short
+Move Search::ponder_move(const RootMove& rm) const {
+    if (rm.pv.length > 1 && rm.pv(1))
+        return rm.pv(1);
+
+    Board child = board;
+    child.make_move(rm);
+
+    const auto* ent = tt_->probe(child.hash());
+    if (!ent)
+        return Move::none();
+
+    const Move move = ent->move();
+    return (move && child.is_pseudo_legal(move) && child.is_legal(move)) ? move : Move::none();
 }
 
 Score Search::aspiration(int depth, Stack* stack) {
@@ -181,7 +287,7 @@ Score Search::aspiration(int depth, Stack* stack) {
         score = negamax<Node::ROOT>(std::max(1, root_depth_ - fail_high_count), alpha, beta, stack);
         sort_root_moves(multipv_idx_);
 
-        if (thread_pool.is_stopped())
+        if (pool_->is_stopped())
             return 0;
 
         if (score <= alpha) {
@@ -220,7 +326,7 @@ Score Search::negamax(int depth, Score alpha, Score beta, Stack* stack, bool cut
         stack->pv.length = stack->ply;
 
     if (limit_reached()) {
-        thread_pool.stop();
+        pool_->stop();
         return 0;
     }
 
@@ -265,7 +371,10 @@ Score Search::negamax(int depth, Score alpha, Score beta, Stack* stack, bool cut
 
     // look up in tt
     bool tt_hit = false;
-    auto* ent = tt.lookup(hash, &tt_hit);
+    auto* ent = tt_lookup(hash, depth, &tt_hit);
+
+    if (limits.tt_stats)
+        record_tt_probe(TTStats::MAIN, ent, tt_hit);
 
     Move tt_move = tt_hit ? ent->move() : Move::none();
     Bound tt_bound = tt_hit ? ent->bound() : Bound::NONE;
@@ -308,7 +417,7 @@ Score Search::negamax(int depth, Score alpha, Score beta, Stack* stack, bool cut
         if (tb_result != TB_RESULT_FAILED) {
             Bound tb_bound;
             Score tb_score;
-            tb_hits_.fetch_add(1, std::memory_order_relaxed);
+            tb_hits_.store(tb_hits_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
 
             if (tb_result == TB_LOSS) {
                 tb_score = stack->ply - SCORE_TB;
@@ -322,7 +431,7 @@ Score Search::negamax(int depth, Score alpha, Score beta, Stack* stack, bool cut
             }
 
             if (tb_bound == Bound::EXACT || (tb_bound == Bound::LOWER ? tb_score >= beta : tb_score <= alpha)) {
-                ent->store(hash, Move::none(), tb_score, SCORE_NONE, tb_bound, depth, stack->ply, tt_pv);
+                tt_store(ent, hash, Move::none(), tb_score, SCORE_NONE, tb_bound, depth, stack->ply, tt_pv);
                 return tb_score;
             }
 
@@ -352,7 +461,7 @@ Score Search::negamax(int depth, Score alpha, Score beta, Stack* stack, bool cut
         if (is_valid(tt_score) && valid_tt_score(tt_score, eval + 1, tt_bound))
             eval = tt_score;
         else if (!tt_hit)
-            ent->store(hash, Move::none(), SCORE_NONE, raw_eval, Bound::NONE, 0, stack->ply, tt_pv);
+            tt_store(ent, hash, Move::none(), SCORE_NONE, raw_eval, Bound::NONE, 0, stack->ply, tt_pv);
     }
 
     if (is_valid((stack - 2)->static_eval))
@@ -417,7 +526,7 @@ Score Search::negamax(int depth, Score alpha, Score beta, Stack* stack, bool cut
         Score score = -negamax<Node::NON_PV>(depth - r, -beta, -beta + 1, stack + 1, !cut_node);
         board.undo_move();
 
-        if (thread_pool.is_stopped())
+        if (pool_->is_stopped())
             return 0;
 
         if (score >= beta && !is_win(score)) {
@@ -465,11 +574,11 @@ Score Search::negamax(int depth, Score alpha, Score beta, Stack* stack, bool cut
 
             undo_move(move);
 
-            if (thread_pool.is_stopped())
+            if (pool_->is_stopped())
                 return 0;
 
             if (score >= probcut_beta) {
-                ent->store(hash, move, score, raw_eval, Bound::LOWER, probcut_depth + 1, stack->ply, tt_pv);
+                tt_store(ent, hash, move, score, raw_eval, Bound::LOWER, probcut_depth + 1, stack->ply, tt_pv);
 
                 if (!is_decisive(score))
                     return score - (probcut_beta - beta);
@@ -477,6 +586,44 @@ Score Search::negamax(int depth, Score alpha, Score beta, Stack* stack, bool cut
         }
     }
 
+    // enhanced transposition cutoff
+    if (limits.etc && !pv_node && !stack->skipped && depth >= etc_min_depth && !is_decisive(beta)) {
+        constexpr int max_etc_moves = 16;
+
+        MovePicker<SearchType::NEGAMAX> etc_mp(board, tt_move, quiet_history_, pawn_history_, noisy_history_, stack);
+        NDArray<Move, max_etc_moves> etc_moves_list;
+        NDArray<Hash, max_etc_moves> etc_keys;
+        int etc_count = 0;
+
+        // prefetch all children first, so their buckets load in parallel
+        Move move = Move::none();
+        while (etc_count < std::min<int>(etc_moves, max_etc_moves) && (move = etc_mp.next())) {
+            if (!board.is_legal(move))
+                continue;
+
+            etc_moves_list(etc_count) = move;
+            etc_keys(etc_count) = board.key_after(move);
+            tt_->prefetch(etc_keys(etc_count));
+            etc_count++;
+        }
+
+        for (int i = 0; i < etc_count; ++i) {
+            const auto* child = tt_->probe(etc_keys(i));
+            if (!child || child->depth() < depth - 1)
+                continue;
+
+            // an upper bound for the child is a lower bound for us
+            const Score child_score = child->score(stack->ply + 1);
+            if (!is_valid(child_score) || is_decisive(child_score) || -child_score < beta)
+                continue;
+            if (child->bound() != Bound::UPPER && child->bound() != Bound::EXACT)
+                continue;
+
+            tt_store(ent, hash, etc_moves_list(i), -child_score, raw_eval, Bound::LOWER, depth, stack->ply, tt_pv);
+            return -child_score;
+        }
+    }
+
 movesloop:
 
     MovePicker<SearchType::NEGAMAX> mp(board, tt_move, quiet_history_, pawn_history_, noisy_history_, stack);
@@ -558,7 +705,7 @@ movesloop:
             Score score = negamax<Node::NON_PV>((depth - 1) / 2, sbeta - 1, sbeta, stack, cut_node);
             stack->skipped = Move::none();
 
-            if (thread_pool.is_stopped())
+            if (pool_->is_stopped())
                 return 0;
 
             if (score < sbeta) {
@@ -578,6 +725,8 @@ movesloop:
 
         make_move(move, stack);
 
+        const BreadcrumbMark mark(pool_, this, board.hash(), limits.breadcrumbs && stack->ply < breadcrumb_max_ply);
+
         Score score = SCORE_NONE;
 
         // late move reductions
@@ -585,6 +734,8 @@ movesloop:
 
             r += !improving * lmr_improving;
 
+            r += mark.busy() * lmr_busy;
+
             if (cut_node)
                 r += lmr_cut_node + !tt_move * lmr_cut_node_no_tt_move;
 
@@ -634,7 +785,7 @@ movesloop:
 
         assert(is_valid(score));
 
-        if (thread_pool.is_stopped())
+        if (pool_->is_stopped())
             return 0;
 
         if (root_node) {
@@ -700,7 +851,7 @@ movesloop:
     // store in tt
     Bound bound = (best_score >= beta) ? Bound::LOWER : (best_score <= old_alpha) ? Bound::UPPER : Bound::EXACT;
     if (!stack->skipped && !(root_node && multipv_idx_))
-        ent->store(hash, best_move, best_score, raw_eval, bound, depth, stack->ply, tt_pv);
+        tt_store(ent, hash, best_move, best_score, raw_eval, bound, depth, stack->ply, tt_pv);
 
     // update correction histories
     if (!in_check                                                //
@@ -733,7 +884,7 @@ Score Search::quiescence(Score alpha, Score beta, Stack* stack) {
         sel_depth_ = std::max(sel_depth_, stack->ply);
     }
 
-    if (thread_pool.is_stopped())
+    if (pool_->is_stopped())
         return 0;
 
     if (board.is_draw(stack->ply))
@@ -759,7 +910,10 @@ Score Search::quiescence(Score alpha, Score beta, Stack* stack) {
 
     // look up in tt
     bool tt_hit = false;
-    auto* ent = tt.lookup(hash, &tt_hit);
+    auto* ent = tt_lookup(hash, 0, &tt_hit);
+
+    if (limits.tt_stats)
+        record_tt_probe(TTStats::QSEARCH, ent, tt_hit);
 
     Move tt_move = tt_hit ? ent->move() : Move::none();
     Bound tt_bound = tt_hit ? ent->bound() : Bound::NONE;
@@ -785,7 +939,7 @@ Score Search::quiescence(Score alpha, Score beta, Stack* stack) {
             if (!is_decisive(best_score))
                 best_score = (best_score + beta) / 2;
             if (!tt_hit)
-                ent->store(hash, Move::none(), SCORE_NONE, raw_eval, Bound::NONE, 0, stack->ply, false);
+                tt_store(ent, hash, Move::none(), SCORE_NONE, raw_eval, Bound::NONE, 0, stack->ply, false);
             return best_score;
         }
 
@@ -832,7 +986,7 @@ Score Search::quiescence(Score alpha, Score beta, Stack* stack) {
 
         assert(is_valid(score));
 
-        if (thread_pool.is_stopped())
+        if (pool_->is_stopped())
             return 0;
 
         if (score > best_score) {
@@ -856,7 +1010,7 @@ Score Search::quiescence(Score alpha, Score beta, Stack* stack) {
         best_score = (best_score + beta) / 2;
 
     Bound bound = (best_score >= beta) ? Bound::LOWER : Bound::UPPER;
-    ent->store(hash, best_move, best_score, raw_eval, bound, 0, stack->ply, tt_pv);
+    tt_store(ent, hash, best_move, best_score, raw_eval, bound, 0, stack->ply, tt_pv);
 
     assert(is_valid(best_score));
 
@@ -866,7 +1020,11 @@ Score Search::quiescence(Score alpha, Score beta, Stack* stack) {
 void Search::make_move(Move move, Stack* stack) {
     assert(stack != nullptr);
 
-    nodes_.fetch_add(1, std::memory_order_relaxed);
+    nodes_.store(nodes_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    // start loading the child bucket while the move is being made
+    const Hash key = board.key_after(move);
+    tt_->prefetch(key);
 
     Piece moved_piece = board.piece_at(move.from());
 
@@ -878,7 +1036,7 @@ void Search::make_move(Move move, Stack* stack) {
     stack->cont_hist = cont_history_.get(board.in_check(), move.is_noisy(), moved_piece, move.to());
     stack->cont_corr_hist = cont_corr_history_.get(moved_piece, move.to());
 
-    tt.prefetch(board.hash());
+    assert(board.hash() == key);
 }
 
 void Search::undo_move(Move move) {
@@ -886,6 +1044,54 @@ void Search::undo_move(Move move) {
     board.undo_move(move);
 }
 
+// shallow nodes use the local table and only read from the shared one
+TTable::Entry* Search::tt_lookup(Hash hash, int depth, bool* hit) {
+    if (!local_tt_.enabled() || depth > limits.local_tt_depth)
+        return tt_->lookup(hash, hit);
+
+    auto* ent = local_tt_.lookup(hash, tt_->age(), hit);
+    if (!*hit) {
+        if (const auto* shared = tt_->probe(hash)) {
+            *ent = *shared;
+            ent->refresh_age(tt_->age());
+            *hit = true;
+        }
+    }
+
+    return ent;
+}
+
+// a hit whose move isn't even pseudo legal here is a key collision
+void Search::record_tt_probe(TTStats::Kind kind, const TTable::Entry* ent, bool hit) {
+    TTStats::bump(tt_stats_.probes(kind));
+
+    if (hit) {
+        TTStats::bump(tt_stats_.hits(kind));
+        if (ent->move() && !board.is_pseudo_legal(ent->move()))
+            TTStats::bump(tt_stats_.false_hits(kind));
+    } else if (!ent->hash()) {
+        TTStats::bump(tt_stats_.fills);
+    } else if (ent->relative_age(tt_->age())) {
+        TTStats::bump(tt_stats_.age_replacements);
+    } else {
+        TTStats::bump(tt_stats_.depth_replacements);
+    }
+}
+
+void Search::tt_store(
+    TTable::Entry* ent, Hash hash, Move move, Score score, Score eval, Bound bound, int depth, int ply, bool pv
+) {
+    if (limits.tt_stats)
+        TTStats::bump(tt_stats_.stores(static_cast<int>(bound)));
+    ent->store(hash, move, score, eval, bound, depth, ply, pv, tt_->age());
+
+    // only qsearch results stay private to the thread
+    if (limits.local_tt_promote && depth > 0 && local_tt_.contains(ent)) {
+        bool hit = false;
+        tt_->lookup(hash, &hit)->store(hash, move, score, eval, bound, depth, ply, pv, tt_->age());
+    }
+}
+
 Score Search::evaluate() {
     assert(accum_list_[0].initialized(WHITE));
     assert(accum_list_[0].initialized(BLACK));
@@ -981,14 +1187,53 @@ unsigned int Search::probe_wdl() const {
     );
 }
 
-bool Search::limit_reached() const {
-    if (this != thread_pool.main_thread())
+// in nodes when the time limits are given in nodes
+int64_t Search::elapsed() const { return limits.nodes_time ? pool_->clock_nodes() : tm_.elapsed_time(); }
+
+// how much longer than usual to think, given how much of the machine we actually got
+double Search::load_factor() const {
+    const int64_t wall = tm_.elapsed_time();
+    if (wall < 50)
+        return 1.0;
+
+    const double cpu_ratio = std::min(1.0, tm_.elapsed_cpu_time() / static_cast<double>(wall));
+
+    // nps also depends on the position, so a small drop isn't blamed on the load
+    const uint64_t nps = pool_->total_nodes() * 1000 / wall;
+    const uint64_t baseline = limits.baseline_nps ? limits.baseline_nps : pool_->peak_nps();
+    const double nps_ratio = baseline ? std::min(1.0, nps / (baseline * 0.8)) : 1.0;
+
+    const double share = std::max(std::min(cpu_ratio, nps_ratio), 1.0 / max_load_extension);
+    const double factor = 1.0 / share;
+
+    if (!limits.minimal)
+        println(
+            "info string Load cpu {}% nps {} baseline {} ({}%) soft time x{:.2f}",
+            static_cast<int>(cpu_ratio * 100),
+            nps,
+            baseline,
+            baseline ? nps * 100 / baseline : 100,
+            factor
+        );
+
+    return factor;
+}
+
+bool Search::limit_reached() {
+    if (this != pool_->main_thread())
         return false;
-    if (limits.nodes && thread_pool.total_nodes() >= limits.nodes)
-        return true;
-    if (limits.time.maximum && tm_.elapsed_time() >= limits.time.maximum)
+
+    // reading the clock and the nodes of every thread isn't free, so only check every few nodes
+    const uint64_t nodes = nodes_.load(std::memory_order_relaxed);
+    if (nodes < next_limit_check_)
+        return false;
+    next_limit_check_ = nodes + limit_check_interval_;
+    if (limits.nodes && pool_->total_nodes() >= limits.nodes)
         return true;
-    return false;
+
+    // a wall clock hard limit is enforced by the thread pool's watchdog
+    return limits.nodes_time && limits.time.maximum > 0
+           && pool_->clock_nodes() >= static_cast<uint64_t>(limits.time.maximum);
 }
 
 void Search::sort_root_moves(int offset) {
@@ -1025,33 +1270,55 @@ void Search::update_histories(Move best_move, MoveList<Move>& quiets, MoveList<M
 }
 
 void Search::print_uci_info() const {
+    if (!pool_->uci_output() && !pool_->has_info_handler())
+        return;
+
     const auto& rm = root_moves_[multipv_idx_];
     const int64_t elapsed_time = tm_.elapsed_time();
-    const uint64_t total_nodes = thread_pool.total_nodes();
-
-    print("info depth {} seldepth {} multipv {} score ", completed_depth_, rm.sel_depth, multipv_idx_ + 1);
+    const uint64_t total_nodes = pool_->total_nodes();
+
+    SearchInfo info;
+    info.depth = completed_depth_;
+    info.sel_depth = rm.sel_depth;
+    info.multipv = multipv_idx_ + 1;
+    info.mate = std::abs(rm.score) >= SCORE_MATE_IN_MAX_PLY;
+    info.score = info.mate ? (SCORE_MATE - std::abs(rm.score) + 1) / 2 * (rm.score > 0 ? 1 : -1)
+                           : normalize_score(rm.score);
+    info.nodes = total_nodes;
+    info.nps = total_nodes * 1000 / (elapsed_time + 1);
+    info.tb_hits = pool_->tb_hits();
+    info.hashfull = tt_->hashfull();
+    info.time_ms = elapsed_time;
+
+    info.pv.push_back(rm);
+    for (int i = 1; i < rm.pv.length && rm.pv(i); ++i)
+        info.pv.push_back(rm.pv(i));
+
+    if (pool_->has_info_handler()) {
+        pool_->send_info(info);
+        return;
+    }
 
-    if (std::abs(rm.score) >= SCORE_MATE_IN_MAX_PLY)
-        print("mate {}", (SCORE_MATE - std::abs(rm.score) + 1) / 2 * (rm.score > 0 ? 1 : -1));
-    else
-        print("cp {}", normalize_score(rm.score));
+    print(
+        "info depth {} seldepth {} multipv {} score {} {}",
+        info.depth,
+        info.sel_depth,
+        info.multipv,
+        info.mate ? "mate" : "cp",
+        info.score
+    );
 
     print(
-        " nodes {} nps {} tbhits {} hashfull {} time {} pv {}",
-        total_nodes,
-        total_nodes * 1000 / (elapsed_time + 1),
-        thread_pool.tb_hits(),
-        tt.hashfull(),
-        elapsed_time,
-        static_cast<const Move&>(rm)
+        " nodes {} nps {} tbhits {} hashfull {} time {} pv",
+        info.nodes,
+        info.nps,
+        info.tb_hits,
+        info.hashfull,
+        info.time_ms
     );
 
-    for (int i = 1; i < rm.pv.length; ++i) {
-        Move move = rm.pv(i);
-        if (!move)
-            break;
+    for (Move move : info.pv)
         print(" {}", move);
-    }
 
     println("");
 }
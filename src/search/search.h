@@ -2,7 +2,10 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <vector>
 
 #include "../chess/board.h"
 #include "../chess/movegen.h"
@@ -16,6 +19,30 @@ namespace astra::search {
 
 enum class Node : uint8_t { ROOT, PV, NON_PV };
 
+class ThreadPool;
+class Search;
+
+// a position near the root that some thread of the pool is searching right now
+struct Breadcrumb {
+    std::atomic<const Search*> owner;
+    std::atomic<Hash> key;
+};
+
+// what an info line reports, handed to embedders instead of text
+struct SearchInfo {
+    int depth = 0;
+    int sel_depth = 0;
+    int multipv = 1;
+    bool mate = false;
+    int score = 0; // centipawns, or moves to mate when mate is set
+    uint64_t nodes = 0;
+    uint64_t nps = 0;
+    uint64_t tb_hits = 0;
+    int hashfull = 0;
+    int64_t time_ms = 0;
+    std::vector<Move> pv;
+};
+
 struct RootMove : public Move {
     RootMove() = default;
     explicit RootMove(Move m)
@@ -30,7 +57,19 @@ struct RootMove : public Move {
 
 class Search {
   public:
-    Search() { clear_histories(); }
+    // uses the given node histories, or its own if there are none to share
+    Search(ThreadPool* pool, TTable* tt, NodeHistories* shared = nullptr)
+        : pool_(pool),
+          tt_(tt),
+          own_histories_(shared ? nullptr : new NodeHistories),
+          pawn_history_(shared ? shared->pawn : own_histories_->pawn),
+          corr_histories_(shared ? shared->corr : own_histories_->corr) {
+        clear_histories();
+    }
+
+    // large and written by one thread only, so it goes on hugepages first touched by that thread
+    static void* operator new(size_t size) { return alloc_align(size); }
+    static void operator delete(void* ptr) { free_align(ptr); }
 
     bool exiting = false;
     bool searching = false;
@@ -41,15 +80,36 @@ class Search {
     Board board;
     Limits limits;
 
+    // runs instead of a search when set
+    std::function<void()> job;
+
     void idle();
     void clear_histories();
+    void copy_histories(const Search& other, bool node_histories);
+
+    void reset_counters() {
+        nodes_ = 0;
+        tb_hits_ = 0;
+    }
 
     uint64_t nodes() const { return nodes_.load(std::memory_order_relaxed); }
     uint64_t tb_hits() const { return tb_hits_.load(std::memory_order_relaxed); }
     int completed_depth() const { return completed_depth_; }
     const RootMove& best_root_move() const { return root_moves_[0]; }
+    const TTStats& tt_stats() const { return tt_stats_; }
+    void reset_tt_stats() { tt_stats_ = TTStats{}; }
+    void resize_local_tt(uint64_t size_kb) { local_tt_.resize(size_kb); }
+    void clear_local_tt() { local_tt_.clear(); }
+
+    // internal score to centipawns for the current material
+    Score normalize_score(Score score) const;
 
   private:
+    ThreadPool* pool_;
+    TTable* tt_;
+
+    std::unique_ptr<NodeHistories> own_histories_;
+
     TimeMan tm_;
 
     nnue::AccumulatorList accum_list_;
@@ -57,12 +117,20 @@ class Search {
 
     QuietHistory quiet_history_;
     NoisyHistory noisy_history_;
-    PawnHistory pawn_history_;
+    PawnHistory& pawn_history_;
     ContinuationHistory cont_history_;
-    CorrectionHistories corr_histories_;
+    CorrectionHistories& corr_histories_;
     ContinuationCorrectionHistory cont_corr_history_;
 
-    std::atomic<uint64_t> nodes_, tb_hits_;
+    // only written by this thread, other threads read them, so they get their own cache line.
+    // with a single writer a relaxed load and store is enough, no locked add needed
+    alignas(64) std::atomic<uint64_t> nodes_;
+    std::atomic<uint64_t> tb_hits_;
+    alignas(64) uint64_t next_limit_check_;
+    uint64_t limit_check_interval_;
+
+    TTStats tt_stats_;
+    LocalTTable local_tt_;
 
     int multipv_idx_;
     int sel_depth_;
@@ -83,20 +151,26 @@ class Search {
     void make_move(Move move, Stack* stack);
     void undo_move(Move move);
 
+    TTable::Entry* tt_lookup(Hash hash, int depth, bool* hit);
+    void record_tt_probe(TTStats::Kind kind, const TTable::Entry* ent, bool hit);
+    void tt_store(TTable::Entry* ent, Hash hash, Move move, Score score, Score eval, Bound bound, int depth, int ply, bool pv);
+
     Score evaluate();
     Score adjust_eval(int32_t eval, int correction_val) const;
     Score draw_score() const;
-    Score normalize_score(Score score) const;
 
     int correction_value(Stack* stack) const;
 
     unsigned int probe_wdl() const;
-    bool limit_reached() const;
+    int64_t elapsed() const;
+    double load_factor() const;
+    bool limit_reached();
     void sort_root_moves(int offset);
     bool found_root_move(Move move);
     void update_quiet_histories(Move best_move, int bonus, Stack* stack);
     void update_histories(Move best_move, MoveList<Move>& quiets, MoveList<Move>& noisy, int depth, Stack* stack);
     void print_uci_info() const;
+    Move ponder_move(const RootMove& rm) const;
 };
 
 } // namespace astra::search
@@ -1,6 +1,9 @@
 #include <algorithm>
 #include <unordered_map>
 
+#include "../chess/movegen.h"
+#include "../util.h"
+#include "numa.h"
 #include "threads.h"
 #include "types.h"
 
@@ -9,60 +12,406 @@ namespace astra::search {
 void ThreadPool::set_count(int count) {
     stop();
     wait();
-    terminate();
 
-    started_threads_ = 0;
+    // the nps baseline scales with the thread count
+    peak_nps_ = 0;
 
-    threads_.reserve(count);
-    running_threads_.reserve(count);
+    start_watchdog();
 
-    for (int i = 0; i < count; ++i) {
-        threads_.emplace_back(std::make_unique<Search>());
-        running_threads_.emplace_back(std::make_unique<std::thread>(&Search::idle, threads_[i].get()));
-    }
+    const std::vector<int> cpus = numa::placement(binding_);
+
+    // threads that stay keep their search data, only the difference is started or stopped
+    if (count < size())
+        remove_threads(count);
+    else if (count > size())
+        add_threads(count, cpus);
 
-    // give threads a moment to start up
-    while (started_threads_ < static_cast<size_t>(count)) {
+    if (!cpus.empty() && uci_output()) {
+        for (const auto& node : numa::nodes()) {
+            int thread_count = 0;
+            std::vector<int> used;
+
+            for (int i = 0; i < count; ++i) {
+                const int cpu = cpus[i % cpus.size()];
+                if (std::ranges::find(node.cpus, cpu) == node.cpus.end())
+                    continue;
+
+                thread_count++;
+                if (std::ranges::find(used, cpu) == used.end())
+                    used.push_back(cpu);
+            }
+
+            std::ranges::sort(used);
+            println("info string Node {} runs {} threads on cpus {}", node.id, thread_count, numa::cpu_list_str(used));
+        }
     }
+
+    if ((count > 1 || share_history_) && uci_output())
+        print_memory(count);
 }
 
-void ThreadPool::wait(bool include_main) {
-    for (size_t i = (include_main ? 0 : 1); i < threads_.size(); ++i) {
-        std::unique_lock search_lock(threads_[i]->mutex);
-        threads_[i]->cv.wait(search_lock, [this, i] { return !threads_[i]->searching; });
+void ThreadPool::add_threads(int count, const std::vector<int>& cpus) {
+    const int old_count = size();
+
+    // new threads start out with what the main thread has learned so far
+    const Search* warm = old_count ? threads_[0].get() : nullptr;
+
+    threads_.resize(count);
+    thread_histories_.resize(count);
+    running_threads_.reserve(count);
+
+    for (int i = old_count; i < count; ++i) {
+        const int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+
+        bool created = false;
+        NodeHistories* hist = share_history_ ? node_histories(cpu, &created) : nullptr;
+        thread_histories_[i] = hist;
+
+        running_threads_.emplace_back(std::make_unique<std::thread>([this, i, cpu, hist, created, warm] {
+            // bind first, so the search data is first touched on the node of the thread
+            if (cpu >= 0)
+                numa::bind_cpus({cpu});
+
+            threads_[i] = std::make_unique<Search>(this, tt_, hist);
+            if (warm)
+                threads_[i]->copy_histories(*warm, !hist || created);
+            threads_[i]->resize_local_tt(local_tt_kb_);
+            threads_[i]->idle();
+        }));
     }
+
+    std::unique_lock lock(started_mutex_);
+    started_cv_.wait(lock, [this, count] { return started_threads_ == static_cast<size_t>(count); });
 }
 
-void ThreadPool::terminate() {
-    for (auto& th : threads_) {
+void ThreadPool::remove_threads(int count) {
+    for (int i = count; i < size(); ++i) {
+        auto& th = threads_[i];
         std::lock_guard lock(th->mutex);
         th->exiting = true;
         th->searching = true;
         th->cv.notify_all();
     }
+    epoch_++;
+
+    for (size_t i = count; i < running_threads_.size(); ++i)
+        if (running_threads_[i] && running_threads_[i]->joinable())
+            running_threads_[i]->join();
+
+    threads_.resize(count);
+    running_threads_.resize(count);
+    thread_histories_.resize(count);
+
+    {
+        std::lock_guard lock(started_mutex_);
+        started_threads_ = count;
+    }
+
+    // nodes without threads left don't need their histories anymore
+    std::erase_if(node_histories_, [this](const auto& entry) {
+        return std::ranges::find(thread_histories_, entry.second.get()) == thread_histories_.end();
+    });
+}
+
+// placement changes for every thread, so they are all started again
+void ThreadPool::restart() {
+    const int count = size();
+    if (!count)
+        return;
+
+    stop();
+    wait();
+    terminate();
+    set_count(count);
+}
+
+void ThreadPool::add_started_thread() {
+    std::lock_guard lock(started_mutex_);
+    started_threads_++;
+    started_cv_.notify_all();
+}
+
+// the set shared by the node of the cpu, unbound threads can run anywhere so they all share one
+NodeHistories* ThreadPool::node_histories(int cpu, bool* created) {
+    int node_id = -1;
+    if (cpu >= 0) {
+        const auto it = std::ranges::find_if(numa::cpus(), [cpu](const auto& c) { return c.id == cpu; });
+        node_id = (it != numa::cpus().end()) ? it->node : -1;
+    }
+
+    auto& hist = node_histories_[node_id];
+    *created = !hist;
+
+    if (!hist) {
+        // the pages are placed before the constructor touches them
+        void* mem = alloc_align(sizeof(NodeHistories));
+        const auto node = std::ranges::find_if(numa::nodes(), [node_id](const auto& n) { return n.id == node_id; });
+        if (node != numa::nodes().end())
+            numa::prefer_memory(mem, sizeof(NodeHistories), *node);
+
+        hist.reset(::new (mem) NodeHistories);
+    }
+
+    return hist.get();
+}
+
+void ThreadPool::print_memory(int count) const {
+    constexpr double MB = 1024.0 * 1024.0;
+
+    const size_t shared_size = node_histories_.size() * sizeof(NodeHistories);
+    const size_t per_thread = sizeof(Search) + (share_history_ ? 0 : sizeof(NodeHistories));
+    const size_t unshared = count * (sizeof(Search) + sizeof(NodeHistories));
+
+    if (!share_history_) {
+        println("info string Search data {:.1f} MB per thread, {:.1f} MB in total", per_thread / MB, unshared / MB);
+        return;
+    }
 
-    // wait for all threads to finish
-    for (auto& running_thread : running_threads_)
-        if (running_thread && running_thread->joinable())
-            running_thread->join();
+    println(
+        "info string Search data {:.1f} MB per thread and {} shared history sets of {:.1f} MB, {:.1f} MB in total "
+        "({:.1f} MB without ShareHistory)",
+        per_thread / MB,
+        node_histories_.size(),
+        sizeof(NodeHistories) / MB,
+        (count * per_thread + shared_size) / MB,
+        unshared / MB
+    );
+}
+
+void ThreadPool::set_binding(numa::BindingPolicy policy) {
+    if (policy == binding_)
+        return;
+
+    binding_ = policy;
+    restart();
+}
 
-    threads_.clear();
-    running_threads_.clear();
+void ThreadPool::set_share_history(bool share) {
+    if (share == share_history_)
+        return;
+
+    share_history_ = share;
+    restart();
+}
+
+void ThreadPool::wait(bool include_main) {
+    for (size_t i = (include_main ? 0 : 1); i < threads_.size(); ++i) {
+        std::unique_lock search_lock(threads_[i]->mutex);
+        threads_[i]->cv.wait(search_lock, [this, i] { return !threads_[i]->searching; });
+    }
 }
 
+void ThreadPool::terminate() { remove_threads(0); }
+
 void ThreadPool::launch_workers(const Board& board, Limits limits) {
     stop();
     wait();
 
     stop_ = false;
 
+    // in case the watchdog has to answer before the first iteration completes
+    MoveList<Move> legal_moves;
+    gen_moves<GenType::LEGAL>(legal_moves, board);
+    completed_move_ = 0;
+    fallback_move_ = legal_moves.size() ? legal_moves[0] : Move::none();
+
+    {
+        // when pondering the hard limit is only armed on ponderhit
+        std::lock_guard lock(watchdog_mutex_);
+        bestmove_sent_ = false;
+        pondering_ = limits.ponder;
+        ponderhit_nodes_ = 0;
+        ponder_time_limit_ = limits.nodes_time ? 0 : limits.time.maximum;
+        deadline_armed_ = !limits.ponder && !limits.nodes_time && limits.time.maximum > 0;
+        deadline_ = Clock::now() + std::chrono::milliseconds(limits.time.maximum);
+        search_id_++;
+    }
+    watchdog_cv_.notify_all();
+
     for (auto& th : threads_) {
         std::lock_guard lock(th->mutex);
         th->board = board;
         th->limits = limits;
+        th->reset_counters();
         th->searching = true;
         th->cv.notify_all();
     }
+    epoch_++;
+}
+
+void ThreadPool::set_local_tt_size(uint64_t size_kb) {
+    stop();
+    wait();
+
+    local_tt_kb_ = size_kb;
+    for (auto& th : threads_)
+        th->resize_local_tt(size_kb);
+}
+
+// spins with a growing number of pauses until the epoch changes or the budget runs out
+void ThreadPool::spin_wait(uint64_t epoch) const {
+    const int budget_ms = spin_wait_ms_.load(std::memory_order_relaxed);
+    if (!budget_ms)
+        return;
+
+    const Clock::time_point end = Clock::now() + std::chrono::milliseconds(budget_ms);
+    int pauses = 1;
+
+    while (this->epoch() == epoch && Clock::now() < end) {
+        for (int i = 0; i < pauses; ++i)
+            _mm_pause();
+        pauses = std::min(2 * pauses, 64);
+    }
+}
+
+void ThreadPool::ponderhit() {
+    {
+        std::lock_guard lock(watchdog_mutex_);
+        if (!pondering_ || bestmove_sent_)
+            return;
+
+        ponderhit_nodes_ = total_nodes();
+        pondering_ = false;
+        deadline_armed_ = ponder_time_limit_ > 0;
+        deadline_ = Clock::now() + std::chrono::milliseconds(ponder_time_limit_);
+        search_id_++;
+    }
+    watchdog_cv_.notify_all();
+}
+
+void ThreadPool::wait_ponder() const {
+    while (pondering() && !is_stopped())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+bool ThreadPool::send_bestmove(Move move, Move ponder_move) {
+    if (bestmove_sent_.exchange(true, std::memory_order_acq_rel))
+        return false;
+
+    if (bestmove_handler_)
+        bestmove_handler_(move, ponder_move);
+    else if (ponder_move)
+        println("bestmove {} ponder {}", move, ponder_move);
+    else
+        println("bestmove {}", move);
+
+    {
+        std::lock_guard lock(watchdog_mutex_);
+        deadline_armed_ = false;
+    }
+    watchdog_cv_.notify_all();
+
+    return true;
+}
+
+void ThreadPool::start_watchdog() {
+    if (!watchdog_)
+        watchdog_ = std::make_unique<std::thread>(&ThreadPool::watchdog_loop, this);
+}
+
+void ThreadPool::stop_watchdog() {
+    if (!watchdog_)
+        return;
+
+    {
+        std::lock_guard lock(watchdog_mutex_);
+        watchdog_exiting_ = true;
+    }
+    watchdog_cv_.notify_all();
+
+    watchdog_->join();
+    watchdog_.reset();
+}
+
+void ThreadPool::watchdog_loop() {
+    std::unique_lock lock(watchdog_mutex_);
+
+    while (true) {
+        watchdog_cv_.wait(lock, [&] { return watchdog_exiting_ || deadline_armed_; });
+        if (watchdog_exiting_)
+            return;
+
+        const uint64_t id = search_id_;
+        const Clock::time_point deadline = deadline_;
+
+        const bool disarmed = watchdog_cv_.wait_until(lock, deadline, [&] {
+            return watchdog_exiting_ || !deadline_armed_ || search_id_ != id;
+        });
+        if (disarmed)
+            continue;
+
+        stop();
+
+        // give the main thread the latency budget to answer, then answer for it
+        const auto budget = std::chrono::milliseconds(bestmove_latency_.load());
+        watchdog_cv_.wait_until(lock, deadline + budget, [&] { return watchdog_exiting_ || bestmove_sent_; });
+
+        if (!bestmove_sent_ && !watchdog_exiting_) {
+            const Move completed = Move(completed_move_.load(std::memory_order_relaxed));
+
+            lock.unlock();
+            send_bestmove(completed ? completed : fallback_move_);
+            lock.lock();
+        }
+
+        // a new go may have armed its own deadline while the lock was released
+        if (search_id_ == id)
+            deadline_armed_ = false;
+    }
+}
+
+// hands job(idx) to every worker and returns without waiting for them
+void ThreadPool::run_jobs(const std::function<void(int)>& job) {
+    stop();
+    wait();
+
+    for (size_t i = 0; i < threads_.size(); ++i) {
+        auto& th = threads_[i];
+        std::lock_guard lock(th->mutex);
+        th->job = [job, i] { job(i); };
+        th->searching = true;
+        th->cv.notify_all();
+    }
+    epoch_++;
+}
+
+void ThreadPool::new_game(bool with_tt) {
+    auto clear_tt = with_tt ? tt_->clear_job() : std::function<void(int)>{};
+
+    // a shared set is cleared by the first thread using it
+    std::vector<NodeHistories*> shared(size(), nullptr);
+    for (const auto& [node, hist] : node_histories_) {
+        const auto it = std::ranges::find(thread_histories_, hist.get());
+        if (it != thread_histories_.end())
+            shared[it - thread_histories_.begin()] = hist.get();
+    }
+
+    {
+        std::lock_guard lock(clear_mutex_);
+        pending_clears_ = threads_.size();
+    }
+
+    // every worker clears what it touches during search, on its own node and all at the same time
+    run_jobs([this, clear_tt, shared](int i) {
+        threads_[i]->clear_histories();
+        threads_[i]->reset_tt_stats();
+        threads_[i]->clear_local_tt();
+
+        if (shared[i])
+            shared[i]->clear();
+
+        if (clear_tt)
+            clear_tt(i);
+
+        std::lock_guard lock(clear_mutex_);
+        if (--pending_clears_ == 0)
+            clear_cv_.notify_all();
+    });
+}
+
+void ThreadPool::wait_cleared() const {
+    std::unique_lock lock(clear_mutex_);
+    clear_cv_.wait(lock, [this] { return !pending_clears_; });
 }
 
 Search* ThreadPool::pick_best() {
@@ -1,35 +1,98 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
+#include "numa.h"
 #include "search.h"
 
 namespace astra::search {
 
 class ThreadPool {
+    using Clock = std::chrono::steady_clock;
+
   public:
-    ThreadPool()
-        : stop_(false),
-          started_threads_(0) {}
+    // every search of this pool uses the given table
+    explicit ThreadPool(TTable* table = &tt)
+        : tt_(table),
+          stop_(false),
+          started_threads_(0),
+          local_tt_kb_(0),
+          binding_(numa::BindingPolicy::NONE),
+          bestmove_sent_(true),
+          completed_move_(0),
+          bestmove_latency_(10),
+          epoch_(0),
+          spin_wait_ms_(0),
+          pondering_(false),
+          ponder_time_limit_(0),
+          ponderhit_nodes_(0),
+          peak_nps_(0) {}
 
-    ~ThreadPool() { terminate(); }
+    ~ThreadPool() {
+        terminate();
+        stop_watchdog();
+    }
 
     void set_count(int count);
+    void set_binding(numa::BindingPolicy policy);
+    void set_share_history(bool share);
     void wait(bool include_main = true);
     void terminate();
     void launch_workers(const Board& board, Limits limit);
+    void run_jobs(const std::function<void(int)>& job);
+    void set_local_tt_size(uint64_t size_kb);
     Search* pick_best();
-    void add_started_thread() { ++started_threads_; }
+    void add_started_thread();
+
+    // whoever sends bestmove first wins, returns false if it was already sent
+    bool send_bestmove(Move move, Move ponder_move = Move::none());
+    bool bestmove_sent() const { return bestmove_sent_.load(std::memory_order_acquire); }
+    void set_completed_move(Move move) { completed_move_.store(move.raw(), std::memory_order_relaxed); }
+    void set_bestmove_latency(int ms) { bestmove_latency_ = ms; }
 
-    void new_game() {
-        for (auto& th : threads_)
-            th->clear_histories();
+    // embedders take the results from handlers instead of reading uci output
+    using BestmoveHandler = std::function<void(Move best, Move ponder)>;
+    using InfoHandler = std::function<void(const SearchInfo& info)>;
+    void set_bestmove_handler(BestmoveHandler handler) { bestmove_handler_ = std::move(handler); }
+    void set_info_handler(InfoHandler handler) { info_handler_ = std::move(handler); }
+    bool uci_output() const { return !bestmove_handler_ && !info_handler_; }
+    bool has_info_handler() const { return static_cast<bool>(info_handler_); }
+    void send_info(const SearchInfo& info) const { info_handler_(info); }
+
+    // while pondering neither time limit applies and bestmove is held back
+    bool pondering() const { return pondering_.load(std::memory_order_acquire); }
+    void ponderhit();
+    void wait_ponder() const;
+
+    // fastest unloaded search so far, the baseline for LoadAware when none is given
+    uint64_t peak_nps() const { return peak_nps_.load(std::memory_order_relaxed); }
+    void record_nps(uint64_t nps) {
+        if (nps > peak_nps())
+            peak_nps_.store(nps, std::memory_order_relaxed);
     }
 
+    // only threads of the same pool leave breadcrumbs for each other, other pools search
+    // unrelated positions
+    Breadcrumb& breadcrumb(Hash key) { return breadcrumbs_(key & (breadcrumbs_.total - 1)); }
+
+    // bumped whenever the workers get something to do
+    uint64_t epoch() const { return epoch_.load(std::memory_order_acquire); }
+    void spin_wait(uint64_t epoch) const;
+    void set_spin_wait(int ms) { spin_wait_ms_ = ms; }
+
+    // clears every history, and the tt if asked to, on the workers in the background until wait_cleared
+    void new_game(bool with_tt = true);
+    void wait_cleared() const;
+
     void stop() { stop_ = true; }
     bool is_stopped() const { return stop_.load(std::memory_order_relaxed); }
     Search* main_thread() { return threads_.empty() ? nullptr : threads_[0].get(); }
@@ -42,6 +105,15 @@ class ThreadPool {
         return count;
     }
 
+    bool all_searching() const {
+        return std::ranges::all_of(threads_, [](const auto& t) { return t->nodes() > 0; });
+    }
+
+    // nodes charged to a NodesTime clock. like the wall clock, it only runs from ponderhit on
+    uint64_t clock_nodes() const {
+        return pondering() ? 0 : total_nodes() - ponderhit_nodes_.load(std::memory_order_relaxed);
+    }
+
     uint64_t tb_hits() const {
         uint64_t count = 0;
         for (const auto& t : threads_)
@@ -49,9 +121,63 @@ class ThreadPool {
         return count;
     }
 
+    TTStats tt_stats() const {
+        TTStats stats;
+        for (const auto& t : threads_)
+            stats.add(t->tt_stats());
+        return stats;
+    }
+
   private:
+    TTable* tt_;
+    NDArray<Breadcrumb, 1024> breadcrumbs_;
     std::atomic<bool> stop_;
-    std::atomic<size_t> started_threads_;
+    size_t started_threads_;
+    std::mutex started_mutex_;
+    std::condition_variable started_cv_;
+    uint64_t local_tt_kb_;
+    numa::BindingPolicy binding_;
+
+    bool share_history_ = false;
+    std::unordered_map<int, std::unique_ptr<NodeHistories>> node_histories_; // by node id, -1 when unbound
+    std::vector<NodeHistories*> thread_histories_;
+
+    mutable std::mutex clear_mutex_;
+    mutable std::condition_variable clear_cv_;
+    int pending_clears_ = 0;
+
+    // the watchdog owns the hard time limit, so a descheduled main thread can't lose on time
+    std::unique_ptr<std::thread> watchdog_;
+    std::mutex watchdog_mutex_;
+    std::condition_variable watchdog_cv_;
+    bool watchdog_exiting_ = false;
+    bool deadline_armed_ = false;
+    uint64_t search_id_ = 0;
+    Clock::time_point deadline_;
+    std::atomic<bool> bestmove_sent_;
+    std::atomic<uint16_t> completed_move_;
+    Move fallback_move_;
+    BestmoveHandler bestmove_handler_;
+    InfoHandler info_handler_;
+    std::atomic<int> bestmove_latency_;
+
+    alignas(64) std::atomic<uint64_t> epoch_;
+    std::atomic<int> spin_wait_ms_;
+
+    std::atomic<bool> pondering_;
+    int64_t ponder_time_limit_;
+    std::atomic<uint64_t> ponderhit_nodes_;
+
+    std::atomic<uint64_t> peak_nps_;
+
+    void start_watchdog();
+    void stop_watchdog();
+    void watchdog_loop();
+    void add_threads(int count, const std::vector<int>& cpus);
+    void remove_threads(int count);
+    void restart();
+    NodeHistories* node_histories(int cpu, bool* created);
+    void print_memory(int count) const;
     std::vector<std::unique_ptr<Search>> threads_;
     std::vector<std::unique_ptr<std::thread>> running_threads_;
 };
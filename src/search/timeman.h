@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <chrono>
 #include <cstdint>
+#include <ctime>
 #include <string>
 #include <vector>
 
@@ -19,6 +20,16 @@ struct Limits {
     int depth = MAX_PLY - 1;
     int multipv = 1;
     bool minimal = false;
+    bool ponder = false;
+    bool nodes_time = false; // time limits are given in nodes
+    bool tt_stats = false;
+    bool etc = false; // enhanced transposition cutoffs, off until they have been tested
+    bool load_aware = false;
+    bool breadcrumbs = false; // only worth it with more than one thread
+    bool keep_tt_age = false; // set when the table is shared with other pools, its owner ages it
+    uint64_t baseline_nps = 0; // 0 calibrates from the fastest search seen so far
+    int local_tt_depth = 0;
+    bool local_tt_promote = false;
     std::vector<std::string> search_moves{};
 };
 
@@ -27,15 +38,23 @@ class TimeMan {
 
   public:
     TimeMan()
-        : start_time_(Clock::now()) {}
+        : start_time_(Clock::now()),
+          start_cpu_time_(thread_cpu_time()) {}
 
-    void start() { start_time_ = Clock::now(); }
+    // must be called from the thread whose cpu time is measured later on
+    void start() {
+        start_time_ = Clock::now();
+        start_cpu_time_ = thread_cpu_time();
+    }
 
     int64_t elapsed_time() const {
         return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start_time_).count();
     }
 
-    static Time get_optimum(int64_t time_left, int inc, int moves_to_go, int overhead) {
+    // cpu time the calling thread got since start(), lags the wall clock when the machine is overloaded
+    int64_t elapsed_cpu_time() const { return thread_cpu_time() - start_cpu_time_; }
+
+    static Time get_optimum(int64_t time_left, int64_t inc, int moves_to_go, int64_t overhead) {
         Time time;
 
         int mtg = (moves_to_go > 0) ? std::min(50, moves_to_go) : 50;
@@ -54,6 +73,17 @@ class TimeMan {
 
   private:
     Clock::time_point start_time_;
+    int64_t start_cpu_time_;
+
+    static int64_t thread_cpu_time() {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+        timespec ts;
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+            return int64_t(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+#endif
+        // without a thread clock the load always looks idle
+        return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+    }
 };
 
 } // namespace astra::search
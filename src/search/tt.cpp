@@ -1,10 +1,22 @@
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <thread>
 #include <vector>
 
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "../util.h"
+#include "numa.h"
 #include "threads.h"
 #include "tt.h"
 
@@ -14,14 +26,44 @@ constexpr int AGE_STEP = 0x8;
 constexpr int AGE_CYCLE = 255 + AGE_STEP;
 constexpr int AGE_MASK = 0xF8;
 
-void TTEntry::refresh_age() { agepvbound = static_cast<uint8_t>(tt.age() | (agepvbound & (AGE_STEP - 1))); }
-int TTEntry::relative_age() const { return (AGE_CYCLE + tt.age() - agepvbound) & AGE_MASK; }
-uint8_t TTEntry::age() const { return agepvbound & AGE_MASK; }
+constexpr uint64_t TT_FILE_MAGIC = 0x3148534841525441; // "ASTRAHS1"
+constexpr size_t TT_FILE_HEADER_SIZE = 4096;           // keeps the buckets page aligned
+
+struct TTFileHeader {
+    uint64_t magic;
+    uint32_t bucket_bytes;
+    uint32_t bucket_entries;
+    uint64_t bucket_count;
+    uint8_t age;
+    uint32_t users; // processes attached to a shared memory table
+
+    template <typename Bucket>
+    bool valid() const {
+        return magic == TT_FILE_MAGIC              //
+               && bucket_bytes == sizeof(Bucket)   //
+               && bucket_entries == Bucket::SIZE //
+               && bucket_count > 0;
+    }
+};
+
+static_assert(sizeof(TTFileHeader) <= TT_FILE_HEADER_SIZE);
+
+template <typename Key>
+void TTEntry<Key>::refresh_age(uint8_t age) { agepvbound = static_cast<uint8_t>(age | (agepvbound & (AGE_STEP - 1))); }
 
-void TTEntry::store(Hash hash, Move move, Score score, Score eval, Bound bound, int depth, int ply, bool pv) {
-    uint16_t hash16 = static_cast<uint16_t>(hash);
+template <typename Key>
+int TTEntry<Key>::relative_age(uint8_t age) const { return (AGE_CYCLE + age - agepvbound) & AGE_MASK; }
 
-    if (move || hash_ != hash16)
+template <typename Key>
+uint8_t TTEntry<Key>::age() const { return agepvbound & AGE_MASK; }
+
+template <typename Key>
+void TTEntry<Key>::store(
+    Hash hash, Move move, Score score, Score eval, Bound bound, int depth, int ply, bool pv, uint8_t age
+) {
+    const Key key = static_cast<Key>(hash);
+
+    if (move || hash_ != key)
         move_ = move;
 
     if (is_valid(score)) {
@@ -31,79 +73,518 @@ void TTEntry::store(Hash hash, Move move, Score score, Score eval, Bound bound,
             score -= ply;
     }
 
-    if (bound == Bound::EXACT || hash_ != hash16 || depth + 4 + 2 * pv > depth_) {
-        hash_ = hash16;
+    if (bound == Bound::EXACT || hash_ != key || depth + 4 + 2 * pv > depth_) {
+        hash_ = key;
         depth_ = depth;
         score_ = score;
         eval_ = eval;
-        agepvbound = static_cast<uint8_t>(static_cast<uint8_t>(bound) + (pv << 2)) | tt.age();
+        agepvbound = static_cast<uint8_t>(static_cast<uint8_t>(bound) + (pv << 2)) | age;
     }
 }
 
-TTable::TTable(uint64_t size_mb)
-    : buckets_(nullptr) {
+template <size_t B, int E>
+BasicTTable<B, E>::BasicTTable(uint64_t size_mb)
+    : size_mb_(0),
+      buckets_(nullptr),
+      numa_policy_(NumaPolicy::NONE),
+      map_base_(nullptr),
+      map_size_(0),
+      header_(nullptr),
+      shared_(false),
+      pool_(&thread_pool),
+      pending_clears_(0),
+      cleared_buckets_(0) {
     init(size_mb);
 }
 
-TTable::~TTable() { free_align(buckets_); }
+template <size_t B, int E>
+BasicTTable<B, E>::~BasicTTable() { release(); }
+
+template <size_t B, int E>
+void BasicTTable<B, E>::init(uint64_t size_mb) {
+    release();
+
+    size_mb_ = size_mb;
+    uint64_t size_bytes = size_mb * 1024 * 1024;
+    bucket_size_ = size_bytes / sizeof(Bucket);
+
+    if (!shm_name_.empty()) {
+        if (map_shm(shm_name_))
+            return;
+        // keep the name, the segment might fit once Hash is set to the same size
+        println("info string Failed to attach shared hash {}, falling back to memory", shm_name_);
+    }
+
+    if (!file_path_.empty()) {
+        if (map_file(file_path_))
+            return;
+        println("info string Failed to map hash file {}, falling back to memory", file_path_);
+        file_path_.clear();
+    }
+
+    buckets_ = static_cast<Bucket*>(alloc_align(size_bytes));
+
+    apply_numa_policy();
+    clear();
+}
+
+template <size_t B, int E>
+void BasicTTable<B, E>::release() {
+    wait_cleared();
+
+#if defined(__linux__)
+    // the last process leaving removes the segment. one attaching at the same time
+    // keeps its mapping, it just won't share it with anyone
+    if (shared_ && std::atomic_ref(header_->users).fetch_sub(1) == 1)
+        shm_unlink(shm_name_.c_str());
+    shared_ = false;
+
+    if (map_base_) {
+        munmap(map_base_, map_size_);
+        map_base_ = nullptr;
+        header_ = nullptr;
+        buckets_ = nullptr;
+    }
+#endif
 
-void TTable::init(uint64_t size_mb) {
     if (buckets_)
         free_align(buckets_);
+    buckets_ = nullptr;
+}
 
-    uint64_t size_bytes = size_mb * 1024 * 1024;
-    bucket_size_ = size_bytes / sizeof(TTBucket);
+template <size_t B, int E>
+void BasicTTable<B, E>::set_file(const std::string& path) {
+    if (path == file_path_)
+        return;
+
+    file_path_ = path;
+    init(size_mb_);
+}
+
+template <size_t B, int E>
+void BasicTTable<B, E>::set_shm(const std::string& name) {
+    // posix requires the name to start with a slash
+    const std::string shm_name = (name.empty() || name[0] == '/') ? name : "/" + name;
+    if (shm_name == shm_name_)
+        return;
+
+    shm_name_ = shm_name;
+    init(size_mb_);
+}
+
+// attaches to a shared memory segment, creating it if this is the first process.
+// a new segment is zero filled, which is an empty table, so it never needs a clear
+template <size_t B, int E>
+bool BasicTTable<B, E>::map_shm(const std::string& name) {
+#if defined(__linux__)
+    const size_t shm_size = TT_FILE_HEADER_SIZE + bucket_size_ * sizeof(Bucket);
+
+    bool created = true;
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        created = false;
+        fd = shm_open(name.c_str(), O_RDWR, 0600);
+    }
+    if (fd < 0)
+        return false;
+
+    if (created && ftruncate(fd, shm_size) != 0) {
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    // the creator might not have resized the segment yet
+    struct stat st{};
+    bool stat_ok = fstat(fd, &st) == 0;
+    for (int i = 0; i < 1000 && stat_ok && st.st_size == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        stat_ok = fstat(fd, &st) == 0;
+    }
 
-    buckets_ = static_cast<TTBucket*>(alloc_align(size_bytes));
+    if (!stat_ok) {
+        close(fd);
+        if (created)
+            shm_unlink(name.c_str());
+        return false;
+    }
+
+    if (static_cast<size_t>(st.st_size) != shm_size) {
+        println("info string Shared hash {} has a different size, all processes need the same Hash", name);
+        close(fd);
+        return false;
+    }
 
+    void* base = mmap(nullptr, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED)
+        return false;
+
+    madvise(base, shm_size, MADV_HUGEPAGE);
+
+    auto* header = static_cast<TTFileHeader*>(base);
+    std::atomic_ref magic(header->magic);
+
+    if (created) {
+        header->bucket_bytes = sizeof(Bucket);
+        header->bucket_entries = Bucket::SIZE;
+        header->bucket_count = bucket_size_;
+        header->age = 0;
+        magic.store(TT_FILE_MAGIC, std::memory_order_release);
+    } else {
+        for (int i = 0; i < 1000 && magic.load(std::memory_order_acquire) != TT_FILE_MAGIC; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    if (!header->template valid<Bucket>() || header->bucket_count != bucket_size_) {
+        println("info string Shared hash {} uses a different bucket layout", name);
+        munmap(base, shm_size);
+        return false;
+    }
+
+    std::atomic_ref(header->users).fetch_add(1);
+
+    map_base_ = base;
+    map_size_ = shm_size;
+    header_ = header;
+    buckets_ = ptr_cast<Bucket>(static_cast<char*>(base) + TT_FILE_HEADER_SIZE);
+    shared_ = true;
+    age_ = std::atomic_ref(header_->age).load();
+
+    println("info string {} shared hash {} ({} MB)", created ? "Created" : "Attached to", name, size_mb_);
+    return true;
+#else
+    (void) name;
+    return false;
+#endif
+}
+
+// maps the hash file shared, so every store ends up in the file. an existing file is
+// only reused if it matches Hash, a new or empty one is created and cleared. anything
+// else is refused, so a mistyped Hash can't wipe a saved table
+template <size_t B, int E>
+bool BasicTTable<B, E>::map_file(const std::string& path) {
+#if defined(__linux__)
+    const size_t file_size = TT_FILE_HEADER_SIZE + bucket_size_ * sizeof(Bucket);
+
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return false;
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    const bool reuse = static_cast<size_t>(st.st_size) == file_size;
+    if (!reuse && st.st_size != 0) {
+        println("info string Hash file {} doesn't match Hash {} MB, refusing to overwrite it", path, size_mb_);
+        close(fd);
+        return false;
+    }
+
+    if (!reuse && ftruncate(fd, file_size) != 0) {
+        close(fd);
+        return false;
+    }
+
+    void* base = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED)
+        return false;
+
+    auto* header = static_cast<TTFileHeader*>(base);
+    if (reuse && (!header->template valid<Bucket>() || header->bucket_count != bucket_size_)) {
+        println("info string Hash file {} uses a different bucket layout, refusing to overwrite it", path);
+        munmap(base, file_size);
+        return false;
+    }
+
+    map_base_ = base;
+    map_size_ = file_size;
+    header_ = header;
+    buckets_ = ptr_cast<Bucket>(static_cast<char*>(base) + TT_FILE_HEADER_SIZE);
+
+    if (reuse) {
+        age_ = header_->age;
+        println("info string Reusing hash file {} ({} MB)", path, size_mb_);
+        return true;
+    }
+
+    *header_ = TTFileHeader{TT_FILE_MAGIC, sizeof(Bucket), Bucket::SIZE, bucket_size_, 0, 0};
     clear();
+
+    return true;
+#else
+    (void) path;
+    return false;
+#endif
+}
+
+template <size_t B, int E>
+bool BasicTTable<B, E>::save(const std::string& path) const {
+    wait_cleared();
+
+#if defined(__linux__)
+    // the mapped file is already up to date
+    if (map_base_ && header_ && path == file_path_)
+        return msync(map_base_, map_size_, MS_SYNC) == 0;
+#endif
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+
+    TTFileHeader header{TT_FILE_MAGIC, sizeof(Bucket), Bucket::SIZE, bucket_size_, age_, 0};
+    std::vector<char> header_block(TT_FILE_HEADER_SIZE, 0);
+    std::memcpy(header_block.data(), &header, sizeof(header));
+    file.write(header_block.data(), header_block.size());
+
+    constexpr uint64_t chunk_buckets = 1 << 20;
+    for (uint64_t i = 0; i < bucket_size_ && file; i += chunk_buckets) {
+        const uint64_t count = std::min(chunk_buckets, bucket_size_ - i);
+        file.write(ptr_cast<const char>(&buckets_[i]), count * sizeof(Bucket));
+    }
+
+    return static_cast<bool>(file);
+}
+
+// replaces the current table with the one stored in the file. on linux the file is
+// mapped privately, so pages are only read once they are probed
+template <size_t B, int E>
+bool BasicTTable<B, E>::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    TTFileHeader header;
+    file.read(ptr_cast<char>(&header), sizeof(header));
+    if (!file || !header.template valid<Bucket>())
+        return false;
+
+    file.seekg(0, std::ios::end);
+    const size_t file_size = TT_FILE_HEADER_SIZE + header.bucket_count * sizeof(Bucket);
+    if (static_cast<size_t>(file.tellg()) < file_size)
+        return false;
+
+#if defined(__linux__)
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    void* base = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED)
+        return false;
+
+    madvise(base, file_size, MADV_RANDOM);
+
+    release();
+    file_path_.clear();
+
+    map_base_ = base;
+    map_size_ = file_size;
+    header_ = static_cast<TTFileHeader*>(base);
+    buckets_ = ptr_cast<Bucket>(static_cast<char*>(base) + TT_FILE_HEADER_SIZE);
+#else
+    release();
+    buckets_ = static_cast<Bucket*>(alloc_align(header.bucket_count * sizeof(Bucket)));
+
+    file.seekg(TT_FILE_HEADER_SIZE);
+    file.read(ptr_cast<char>(buckets_), header.bucket_count * sizeof(Bucket));
+#endif
+
+    bucket_size_ = header.bucket_count;
+    size_mb_ = bucket_size_ * sizeof(Bucket) / (1024 * 1024);
+
+    // the next search increments the age, so loaded entries count as one search old
+    age_ = header.age;
+
+    return true;
+}
+
+template <size_t B, int E>
+void BasicTTable<B, E>::set_numa_policy(NumaPolicy policy) {
+    if (policy == numa_policy_)
+        return;
+
+    numa_policy_ = policy;
+    // memory policies only apply to untouched pages, so we need a fresh table
+    init(size_mb_);
 }
 
-void TTable::clear() {
+template <size_t B, int E>
+void BasicTTable<B, E>::apply_numa_policy() {
+    if (numa_policy_ == NumaPolicy::NONE)
+        return;
+
+    const auto& nodes = numa::nodes();
+    if (nodes.size() < 2) {
+        println("info string NumaPolicy has no effect, only one numa node found");
+        return;
+    }
+
+    if (numa_policy_ == NumaPolicy::INTERLEAVE) {
+        numa::interleave_memory(buckets_, bucket_size_ * sizeof(Bucket));
+        println("info string Hash {} MB interleaved across {} numa nodes", size_mb_, nodes.size());
+        return;
+    }
+
+    const int node_count = nodes.size();
+    for (int n = 0; n < node_count; ++n) {
+        const uint64_t begin = node_boundary(n, node_count);
+        const uint64_t end = node_boundary(n + 1, node_count);
+
+        numa::prefer_memory(&buckets_[begin], (end - begin) * sizeof(Bucket), nodes[n]);
+        println(
+            "info string Hash node {} cpus {} buckets {}-{} ({} MB)",
+            nodes[n].id,
+            numa::cpu_list_str(nodes[n].cpus),
+            begin,
+            end,
+            (end - begin) * sizeof(Bucket) / (1024 * 1024)
+        );
+    }
+}
+
+template <size_t B, int E>
+uint64_t BasicTTable<B, E>::node_boundary(int node, int node_count) const {
+    if (node >= node_count)
+        return bucket_size_;
+
+    // keep slices aligned to huge pages so a page never spans two nodes
+    constexpr uint64_t page_buckets = 2 * 1024 * 1024 / sizeof(Bucket);
+    const uint64_t boundary = bucket_size_ * node / node_count;
+    return boundary - boundary % page_buckets;
+}
+
+template <size_t B, int E>
+void BasicTTable<B, E>::clear() {
+    auto job = clear_job();
+    if (!job)
+        return;
+
+    // no workers yet during static initialization
+    if (!pool_->size())
+        job(0);
+    else
+        pool_->run_jobs(job);
+}
+
+template <size_t B, int E>
+std::function<void(int)> BasicTTable<B, E>::clear_job() {
+    wait_cleared();
+
+    // other processes are still searching with a shared table
+    if (shared_)
+        return {};
+
     age_ = 0;
+    if (header_)
+        header_->age = age_;
+
+    const int node_count = (numa_policy_ == NumaPolicy::PARTITION) ? numa::nodes().size() : 1;
+    const int worker_count = std::max(1, pool_->size());
+
+    // every node gets the same amount of slices, so a slice never spans two nodes
+    const int slices_per_node = (worker_count + node_count - 1) / node_count;
+    const int slice_count = node_count * slices_per_node;
 
-    const int worker_count = std::max(1, thread_pool.size());
-    const uint64_t chunk_size = bucket_size_ / worker_count;
+    auto clear_slices = [this, node_count, worker_count, slices_per_node, slice_count](int worker) {
+        constexpr uint64_t chunk_size = 1 << 16;
 
-    std::vector<std::thread> threads;
-    threads.reserve(worker_count);
+        // workers might be pinned by ThreadBinding, so restore their affinity afterwards
+        const std::vector<int> affinity = (node_count > 1) ? numa::thread_cpus() : std::vector<int>{};
 
-    for (int i = 0; i < worker_count; i++) {
-        threads.emplace_back([this, i, chunk_size]() {
-            for (uint64_t j = 0; j < chunk_size; ++j)
-                buckets_[i * chunk_size + j] = TTBucket{};
-        });
+        for (int i = worker; i < slice_count; i += worker_count) {
+            const int node = i / slices_per_node;
+            const int part = i % slices_per_node;
+
+            // first touch happens on the node the slice belongs to
+            if (node_count > 1)
+                numa::bind_thread(numa::nodes()[node]);
+
+            const uint64_t node_begin = node_boundary(node, node_count);
+            const uint64_t node_size = node_boundary(node + 1, node_count) - node_begin;
+            const uint64_t begin = node_begin + node_size * part / slices_per_node;
+            const uint64_t end = node_begin + node_size * (part + 1) / slices_per_node;
+
+            for (uint64_t j = begin; j < end; j += chunk_size) {
+                const uint64_t chunk_end = std::min(end, j + chunk_size);
+                for (uint64_t k = j; k < chunk_end; ++k)
+                    buckets_[k] = Bucket{};
+                cleared_buckets_.fetch_add(chunk_end - j, std::memory_order_relaxed);
+            }
+        }
+
+        if (!affinity.empty())
+            numa::bind_cpus(affinity);
+    };
+
+    cleared_buckets_ = 0;
+
+    {
+        std::lock_guard lock(clear_mutex_);
+        pending_clears_ = worker_count;
     }
 
-    const uint64_t cleared = chunk_size * worker_count;
-    if (cleared < bucket_size_)
-        for (uint64_t i = cleared; i < bucket_size_; ++i)
-            buckets_[i] = TTBucket{};
+    return [this, clear_slices](int worker) {
+        clear_slices(worker);
+
+        std::lock_guard lock(clear_mutex_);
+        if (--pending_clears_ == 0)
+            clear_cv_.notify_all();
+    };
+}
 
-    for (auto& t : threads)
-        t.join();
+template <size_t B, int E>
+void BasicTTable<B, E>::wait_cleared(bool report) const {
+    std::unique_lock lock(clear_mutex_);
+
+    while (pending_clears_) {
+        if (clear_cv_.wait_for(lock, std::chrono::milliseconds(500), [this] { return !pending_clears_; }))
+            break;
+        if (report)
+            println("info string Clearing hash {}%", 100 * cleared_buckets_.load() / bucket_size_);
+    }
 }
 
-void TTable::increment() { age_ += AGE_STEP; }
+template <size_t B, int E>
+void BasicTTable<B, E>::increment() {
+    // only the first process starting a new search advances the shared age, the others
+    // pick it up, so processes searching side by side don't age each other's entries
+    if (shared_) {
+        uint8_t expected = age_;
+        std::atomic_ref(header_->age).compare_exchange_strong(expected, static_cast<uint8_t>(age_ + AGE_STEP));
+        age_ = (expected == age_) ? age_ + AGE_STEP : expected;
+        return;
+    }
 
-TTEntry* TTable::lookup(Hash hash, bool* hit) const {
-    uint16_t hash16 = static_cast<uint16_t>(hash);
-    auto& entries = buckets_[index(hash)].entries;
+    age_ += AGE_STEP;
+    if (header_)
+        header_->age = age_;
+}
 
-    for (int i = 0; i < TTBucket::SIZE; ++i) {
-        uint16_t entry_hash = entries(i).hash();
-        if (entry_hash == hash16 || !entry_hash) {
-            entries(i).refresh_age();
-            *hit = (entry_hash == hash16);
+template <size_t Bytes, int Entries>
+typename TTBucket<Bytes, Entries>::Entry* TTBucket<Bytes, Entries>::lookup(Key key, uint8_t age, bool* hit) {
+    for (int i = 0; i < SIZE; ++i) {
+        const Key entry_key = entries(i).hash();
+        if (entry_key == key || !entry_key) {
+            entries(i).refresh_age(age);
+            *hit = (entry_key == key);
             return &entries(i);
         }
     }
 
     auto* replace = &entries(0);
-    int min_value = replace->depth() - 4 * replace->relative_age();
+    int min_value = replace->depth() - 4 * replace->relative_age(age);
 
-    for (int i = 1; i < TTBucket::SIZE; ++i) {
-        int value = entries(i).depth() - 4 * entries(i).relative_age();
+    for (int i = 1; i < SIZE; ++i) {
+        int value = entries(i).depth() - 4 * entries(i).relative_age(age);
         if (value < min_value) {
             min_value = value;
             replace = &entries(i);
@@ -114,18 +595,211 @@ TTEntry* TTable::lookup(Hash hash, bool* hit) const {
     return replace;
 }
 
-int TTable::hashfull() const {
-    int used = 0;
-    for (int i = 0; i < 1000; ++i) {
-        for (int j = 0; j < TTBucket::SIZE; ++j) {
+template <size_t B, int E>
+typename BasicTTable<B, E>::Entry* BasicTTable<B, E>::lookup(Hash hash, bool* hit) const {
+    return buckets_[index(hash)].lookup(static_cast<Key>(hash), age_, hit);
+}
+
+// read only lookup, doesn't refresh the age or pick a slot to replace
+template <size_t B, int E>
+const typename BasicTTable<B, E>::Entry* BasicTTable<B, E>::probe(Hash hash) const {
+    const Key key = static_cast<Key>(hash);
+    const auto& entries = buckets_[index(hash)].entries;
+
+    for (int i = 0; i < Bucket::SIZE; ++i)
+        if (entries(i).hash() == key)
+            return &entries(i);
+
+    return nullptr;
+}
+
+// samples the first 1000 buckets unless an exact count over the whole table is asked for
+template <size_t B, int E>
+int BasicTTable<B, E>::hashfull(bool exact) const {
+    const uint64_t bucket_count = exact ? bucket_size_ : std::min<uint64_t>(1000, bucket_size_);
+
+    uint64_t used = 0;
+    for (uint64_t i = 0; i < bucket_count; ++i) {
+        for (int j = 0; j < Bucket::SIZE; ++j) {
             const auto& entry = buckets_[i].entries(j);
             if (entry.age() == age_ && entry.hash() != 0)
                 used++;
         }
     }
-    return used / TTBucket::SIZE;
+    return used * 1000 / (bucket_count * Bucket::SIZE);
 }
 
+LocalTTable::~LocalTTable() { std::free(buckets_); }
+
+void LocalTTable::resize(uint64_t size_kb) {
+    std::free(buckets_);
+    buckets_ = nullptr;
+    bucket_size_ = size_kb * 1024 / sizeof(Bucket);
+
+    if (!bucket_size_)
+        return;
+
+    // keep buckets from straddling cache lines
+    const size_t size_bytes = (bucket_size_ * sizeof(Bucket) + 63) / 64 * 64;
+    buckets_ = static_cast<Bucket*>(std::aligned_alloc(64, size_bytes));
+    clear();
+}
+
+void LocalTTable::clear() {
+    for (uint64_t i = 0; i < bucket_size_; ++i)
+        buckets_[i] = Bucket{};
+}
+
+LocalTTable::Entry* LocalTTable::lookup(Hash hash, uint8_t age, bool* hit) {
+    const size_t idx = (static_cast<unsigned __int128>(hash) * static_cast<unsigned __int128>(bucket_size_)) >> 64;
+    return buckets_[idx].lookup(static_cast<Key>(hash), age, hit);
+}
+
+bool LocalTTable::contains(const Entry* entry) const {
+    const auto* ptr = ptr_cast<const char>(entry);
+    return ptr >= ptr_cast<const char>(buckets_) && ptr < ptr_cast<const char>(buckets_ + bucket_size_);
+}
+
+void TTStats::add(const TTStats& other) {
+    auto load = [](const uint64_t& counter) {
+        return std::atomic_ref(const_cast<uint64_t&>(counter)).load(std::memory_order_relaxed);
+    };
+
+    for (int i = 0; i < 2; ++i) {
+        probes(i) += load(other.probes(i));
+        hits(i) += load(other.hits(i));
+        false_hits(i) += load(other.false_hits(i));
+    }
+
+    for (int i = 0; i < 4; ++i)
+        stores(i) += load(other.stores(i));
+
+    fills += load(other.fills);
+    age_replacements += load(other.age_replacements);
+    depth_replacements += load(other.depth_replacements);
+}
+
+void TTStats::print(int hashfull) const {
+    auto percent = [](uint64_t part, uint64_t total) { return total ? 100.0 * part / total : 0.0; };
+
+    const uint64_t total_probes = probes(MAIN) + probes(QSEARCH);
+    const uint64_t total_hits = hits(MAIN) + hits(QSEARCH);
+    const uint64_t total_false_hits = false_hits(MAIN) + false_hits(QSEARCH);
+
+    println(
+        "info string tt probes {} qsearch {:.1f}% hits {:.1f}% main {:.1f}% qsearch {:.1f}% falsehits {:.3f}%"
+        " stores none {} exact {} lower {} upper {} replaced empty {} age {} depth {} hashfull {}",
+        total_probes,
+        percent(probes(QSEARCH), total_probes),
+        percent(total_hits, total_probes),
+        percent(hits(MAIN), probes(MAIN)),
+        percent(hits(QSEARCH), probes(QSEARCH)),
+        percent(total_false_hits, total_hits),
+        stores(static_cast<int>(Bound::NONE)),
+        stores(static_cast<int>(Bound::EXACT)),
+        stores(static_cast<int>(Bound::LOWER)),
+        stores(static_cast<int>(Bound::UPPER)),
+        fills,
+        age_replacements,
+        depth_replacements,
+        hashfull
+    );
+}
+
+NumaPolicy numa_policy_from_str(const std::string& str) {
+    const std::string policy = to_lower(str);
+    if (policy == "interleave")
+        return NumaPolicy::INTERLEAVE;
+    if (policy == "partition")
+        return NumaPolicy::PARTITION;
+    if (policy != "none")
+        println("info string Unknown NumaPolicy {}, using none", str);
+    return NumaPolicy::NONE;
+}
+
+namespace {
+
+uint64_t mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// synthetic probe/store workload. half of the probes go to a small hot set to mimic
+// transpositions, the rest spread over twice the capacity of the default layout.
+// every stored entry carries a tag derived from the full key, so a hit with the wrong
+// tag is a false hit
+template <size_t B, int E>
+void bench_layout(uint64_t size_mb, uint64_t probes) {
+    using Table = BasicTTable<B, E>;
+    using Bucket = typename Table::Bucket;
+
+    Table table(size_mb);
+    table.wait_cleared();
+
+    const uint64_t capacity = size_mb * 1024 * 1024 / sizeof(Bucket) * Bucket::SIZE;
+    const uint64_t working_set = 2 * size_mb * 1024 * 1024 / sizeof(TTable::Bucket) * TTable::Bucket::SIZE;
+    const uint64_t hot_set = std::max<uint64_t>(1, working_set / 16);
+    const uint64_t probes_per_search = std::max<uint64_t>(1, probes / 32);
+
+    uint64_t seed = 0, hits = 0, false_hits = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < probes; ++i) {
+        if (i % probes_per_search == 0)
+            table.increment();
+
+        const uint64_t r = mix(++seed);
+        const uint64_t id = (r & 1) ? (r >> 1) % hot_set : (r >> 1) % working_set;
+        const Hash hash = mix(id ^ 0x9e3779b97f4a7c15ULL);
+        const Move tag(static_cast<uint16_t>(0x8000 | (mix(hash) & 0x7fff)));
+
+        bool hit = false;
+        auto* ent = table.lookup(hash, &hit);
+
+        if (hit && ent->move() == tag)
+            hits++;
+        else if (hit)
+            false_hits++;
+        else
+            ent->store(hash, tag, 0, 0, Bound::EXACT, r % 16, 0, false, table.age());
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    const double seconds = std::max(1e-9, std::chrono::duration<double>(end - start).count());
+
+    println(
+        "{}B/{} ({} bit keys): {} entries, hit rate {:.2f}%, false hit rate {:.4f}%, {:.2f} Mprobes/s",
+        B,
+        E,
+        8 * sizeof(typename Table::Key),
+        capacity,
+        100.0 * hits / probes,
+        100.0 * false_hits / probes,
+        probes / seconds / 1e6
+    );
+}
+
+} // namespace
+
+void tt_bench(uint64_t size_mb, uint64_t probes) {
+    println("ttbench {} MB, {} probes", size_mb, probes);
+    bench_layout<32, 3>(size_mb, probes);
+    bench_layout<64, 5>(size_mb, probes);
+    bench_layout<64, 6>(size_mb, probes);
+}
+
+template class TTEntry<uint16_t>;
+template class TTEntry<uint32_t>;
+
+template struct TTBucket<32, 3>;
+template struct TTBucket<64, 5>;
+template struct TTBucket<64, 6>;
+
+template class BasicTTable<32, 3>;
+template class BasicTTable<64, 5>;
+template class BasicTTable<64, 6>;
+
 TTable tt(16);
 
 } // namespace astra::search
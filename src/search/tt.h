@@ -1,21 +1,33 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <type_traits>
+
 #include "../chess/types.h"
 #include "types.h"
 
 namespace astra::search {
 
+class ThreadPool;
+
 enum class Bound : uint8_t { NONE, LOWER, UPPER, EXACT };
 
+enum class NumaPolicy : uint8_t { NONE, INTERLEAVE, PARTITION };
+
 #pragma pack(push, 1)
+template <typename Key>
 class TTEntry {
   public:
-    void store(Hash hash, Move move, Score score, Score eval, Bound bound, int depth, int ply, bool pv);
-    void refresh_age();
+    void store(Hash hash, Move move, Score score, Score eval, Bound bound, int depth, int ply, bool pv, uint8_t age);
+    void refresh_age(uint8_t age);
 
-    int relative_age() const;
+    int relative_age(uint8_t age) const;
     uint8_t age() const;
-    uint16_t hash() const { return hash_; }
+    Key hash() const { return hash_; }
     uint8_t depth() const { return depth_; }
     Move move() const { return move_; }
 
@@ -34,7 +46,7 @@ class TTEntry {
     bool tt_pv() const { return agepvbound & 0x4; }
 
   private:
-    uint16_t hash_ = 0;
+    Key hash_ = 0;
     uint8_t depth_ = 0;
     Move move_ = Move::none();
     int16_t score_ = SCORE_NONE;
@@ -43,38 +55,141 @@ class TTEntry {
 };
 #pragma pack(pop)
 
+// entries use 32 bit keys if the bucket has enough padding left for them
+template <size_t Bytes, int Entries>
 struct TTBucket {
-    static constexpr int SIZE = 3;
+    static constexpr int SIZE = Entries;
+
+    using Key = std::conditional_t<(SIZE * sizeof(TTEntry<uint32_t>) < Bytes), uint32_t, uint16_t>;
+    using Entry = TTEntry<Key>;
 
-    NDArray<TTEntry, SIZE> entries;
-    int16_t padding;
+    NDArray<Entry, SIZE> entries;
+    NDArray<uint8_t, Bytes - SIZE * sizeof(Entry)> padding;
+
+    // returns the matching entry, or the one to replace on a miss
+    Entry* lookup(Key key, uint8_t age, bool* hit);
 };
 
-static_assert(sizeof(TTBucket) == 32, "TTBucket is not packed as expected!");
+// counters are only written by their own thread, other threads read them through atomic_ref
+struct TTStats {
+    enum Kind : uint8_t { MAIN, QSEARCH };
+
+    NDArray<uint64_t, 2> probes, hits, false_hits;
+    NDArray<uint64_t, 4> stores; // indexed by bound
+
+    // victims picked by lookup on a miss
+    uint64_t fills = 0;
+    uint64_t age_replacements = 0;
+    uint64_t depth_replacements = 0;
 
-class TTable {
+    void add(const TTStats& other);
+    void print(int hashfull) const;
+
+    static void bump(uint64_t& counter) { std::atomic_ref(counter).store(counter + 1, std::memory_order_relaxed); }
+};
+
+struct TTFileHeader;
+
+template <size_t BucketBytes, int BucketEntries>
+class BasicTTable {
   public:
-    explicit TTable(uint64_t size_mb);
-    ~TTable();
+    using Bucket = TTBucket<BucketBytes, BucketEntries>;
+    using Entry = typename Bucket::Entry;
+    using Key = typename Bucket::Key;
+
+    static_assert(sizeof(Bucket) == BucketBytes, "TTBucket is not packed as expected!");
+
+    explicit BasicTTable(uint64_t size_mb);
+    ~BasicTTable();
 
     void init(uint64_t size_mb);
+    void set_numa_policy(NumaPolicy policy);
+    void set_file(const std::string& path);
+    void set_shm(const std::string& name);
     void clear();
+    // the pool clearing this table, the global one unless set
+    void set_pool(ThreadPool* pool) { pool_ = pool; }
+    // one job per pool worker clearing its slices, counted as pending until it ran. empty if there is nothing to clear
+    std::function<void(int)> clear_job();
+    void wait_cleared(bool report = false) const;
     void increment();
-    TTEntry* lookup(Hash hash, bool* hit) const;
-    int hashfull() const;
+    Entry* lookup(Hash hash, bool* hit) const;
+    const Entry* probe(Hash hash) const;
+    int hashfull(bool exact = false) const;
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
     void prefetch(Hash hash) const { __builtin_prefetch(&buckets_[index(hash)]); }
     int age() const { return age_; }
+    uint64_t size_mb() const { return size_mb_; }
+    const std::string& file_path() const { return file_path_; }
 
   private:
     uint8_t age_;
+    uint64_t size_mb_;
     uint64_t bucket_size_;
-    TTBucket* buckets_;
+    Bucket* buckets_;
+    NumaPolicy numa_policy_;
+
+    // set when the buckets live in a memory mapped hash file
+    std::string file_path_;
+    void* map_base_;
+    size_t map_size_;
+    TTFileHeader* header_;
+
+    // set when the buckets live in a posix shared memory segment used by several processes
+    std::string shm_name_;
+    bool shared_;
+
+    // clearing runs on the thread pool workers in the background
+    ThreadPool* pool_;
+    mutable std::mutex clear_mutex_;
+    mutable std::condition_variable clear_cv_;
+    int pending_clears_;
+    std::atomic<uint64_t> cleared_buckets_;
+
+    void release();
+    bool map_file(const std::string& path);
+    bool map_shm(const std::string& name);
+    void apply_numa_policy();
+    uint64_t node_boundary(int node, int node_count) const;
 
     size_t index(Hash hash) const {
         return (static_cast<unsigned __int128>(hash) * static_cast<unsigned __int128>(bucket_size_)) >> 64;
     }
 };
 
+// build with TT_LARGE_BUCKETS for cache line sized buckets
+#ifdef TT_LARGE_BUCKETS
+using TTable = BasicTTable<64, 5>;
+#else
+using TTable = BasicTTable<32, 3>;
+#endif
+
+// small per thread table in front of the shared one, keeps qsearch and shallow
+// entries from evicting deep ones and stays in the cache of its core
+class LocalTTable {
+  public:
+    using Bucket = TTable::Bucket;
+    using Entry = TTable::Entry;
+    using Key = TTable::Key;
+
+    LocalTTable() = default;
+    LocalTTable(const LocalTTable&) = delete;
+    LocalTTable& operator=(const LocalTTable&) = delete;
+    ~LocalTTable();
+
+    void resize(uint64_t size_kb);
+    void clear();
+    Entry* lookup(Hash hash, uint8_t age, bool* hit);
+
+    bool enabled() const { return bucket_size_ > 0; }
+    bool contains(const Entry* entry) const;
+
+  private:
+    Bucket* buckets_ = nullptr;
+    uint64_t bucket_size_ = 0;
+};
+
 inline bool valid_tt_score(Score tt_score, Score score, Bound bound) {
     if (bound == Bound::LOWER)
         return tt_score >= score;
@@ -83,6 +198,10 @@ inline bool valid_tt_score(Score tt_score, Score score, Bound bound) {
     return bound == Bound::EXACT;
 }
 
+NumaPolicy numa_policy_from_str(const std::string& str);
+
+void tt_bench(uint64_t size_mb, uint64_t probes);
+
 extern TTable tt;
 
 } // namespace astra::search
@@ -85,6 +85,9 @@ PARAM(nmp_eval_div, 167, 50, 350);
 PARAM(pc_margin, 214, 1, 400);
 PARAM(pc_improving_mult, 60, 1, 120);
 
+PARAM(etc_min_depth, 8, 2, 16);
+PARAM(etc_moves, 4, 1, 16);
+
 PARAM(hist_div, 6069, 1, 16384);
 
 PARAM(hp_depth_mult, -6080, -12500, -2500);
@@ -111,6 +114,7 @@ PARAM(lmr_in_check, 1070, 1, 2048);
 PARAM(lmr_corr, 3072, 1, 6144);
 PARAM(lmr_quiet_hist_mul, 96, 1, 300);
 PARAM(lmr_noisy_hist_mul, 78, 1, 300);
+PARAM(lmr_busy, 1024, 0, 2048);
 
 PARAM(dp_margin, 61, 10, 120);
 PARAM(ds_margin, 9, 1, 20);
@@ -52,10 +52,8 @@ void Options::set(const std::string& info) {
         return;
     }
 
-    const std::string& value = tokens[4];
-
-    if (value == "<empty>" || value.empty())
-        return;
+    std::string value = tokens[4];
+    bool empty = (value == "<empty>" || value.empty());
 
     std::string name;
     const std::string lower_input = to_lower(tokens[2]);
@@ -67,11 +65,25 @@ void Options::set(const std::string& info) {
     }
 
     if (!name.empty()) {
-        options_[name].set(value);
+        // paths may contain spaces, so a string takes everything after value
+        if (options_[name].type() == OptionType::STRING) {
+            for (size_t i = 5; i < tokens.size(); i++)
+                value += " " + tokens[i];
+            empty = (value == "<empty>");
+        }
+
+        // only strings can be cleared, like HashFile to go back to plain memory
+        if (empty && options_[name].type() != OptionType::STRING)
+            return;
+
+        options_[name].set(empty ? "" : value);
         apply(name);
         return;
     }
 
+    if (empty)
+        return;
+
     auto it = std::ranges::find_if(search::params, [&](auto* p) { return to_lower(p->name) == lower_input; });
 
     if (it != std::ranges::end(search::params)) {
@@ -110,8 +122,31 @@ void Options::apply(const std::string& name) {
         update_syzygy_path(get(name));
     else if (lower_name == "hash")
         search::tt.init(std::stoi(get(name)));
+    else if (lower_name == "hashfile")
+        search::tt.set_file(get(name));
+    else if (lower_name == "hashshm")
+        search::tt.set_shm(get(name));
+    else if (lower_name == "numapolicy")
+        search::tt.set_numa_policy(search::numa_policy_from_str(get(name)));
+    else if (lower_name == "localhash")
+        search::thread_pool.set_local_tt_size(std::stoi(get(name)));
+    else if (lower_name == "bestmovelatency")
+        search::thread_pool.set_bestmove_latency(std::stoi(get(name)));
+    else if (lower_name == "spinwait")
+        search::thread_pool.set_spin_wait(std::stoi(get(name)));
+    else if (lower_name == "threadbinding")
+        search::thread_pool.set_binding(numa::binding_policy_from_str(get(name)));
+    else if (lower_name == "sharehistory")
+        search::thread_pool.set_share_history(get(name) == "true");
     else if (lower_name == "threads")
         search::thread_pool.set_count(std::stoi(get(name)));
+
+    // a hash file that was refused leaves the table in memory, the option has to say so
+    if (lower_name == "hash" || lower_name == "hashfile") {
+        auto it = options_.find("HashFile");
+        if (it != options_.end() && search::tt.file_path().empty())
+            it->second.set("");
+    }
 }
 
 } // namespace astra::uci
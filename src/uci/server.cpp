@@ -0,0 +1,504 @@
+#include <algorithm>
+#include <limits>
+#include <sstream>
+
+#include "../chess/movegen.h"
+#include "../util.h"
+#include "server.h"
+#include "uci.h"
+
+namespace astra::uci {
+
+namespace {
+
+std::string json_str(const std::string& str) {
+    std::string out = "\"";
+    for (char c : str) {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out + '"';
+}
+
+// quoted when it would break the row
+std::string csv_str(const std::string& str) {
+    if (str.find_first_of(",\"\n") == std::string::npos)
+        return str;
+
+    std::string out = "\"";
+    for (char c : str) {
+        if (c == '"')
+            out += '"';
+        out += c;
+    }
+    return out + '"';
+}
+
+bool has_legal_moves(const Board& board) {
+    MoveList<Move> moves;
+    gen_moves<GenType::LEGAL>(moves, board);
+    return moves.size() > 0;
+}
+
+bool is_number(const std::string& str) {
+    return !str.empty() && std::ranges::all_of(str, [](char c) { return c >= '0' && c <= '9'; });
+}
+
+double percentile(const std::vector<int64_t>& sorted, double p) {
+    if (sorted.empty())
+        return 0;
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))] / 1000.0;
+}
+
+} // namespace
+
+Server::Server(int slot_count, uint64_t hash_mb, bool partition_tt) {
+    for (int i = 0; i < slot_count; ++i) {
+        auto slot = std::make_unique<Slot>();
+
+        search::TTable* table = &search::tt;
+        if (partition_tt) {
+            slot->tt = std::make_unique<search::TTable>(std::max<uint64_t>(1, hash_mb / slot_count));
+            slot->tt->wait_cleared();
+            table = slot->tt.get();
+        }
+
+        slot->pool = std::make_unique<search::ThreadPool>(table);
+        if (slot->tt)
+            slot->tt->set_pool(slot->pool.get());
+
+        Slot* s = slot.get();
+        slot->pool->set_bestmove_handler([s](Move best, Move ponder) {
+            std::lock_guard lock(s->result_mutex);
+            s->best_move = best;
+            s->ponder_move = ponder;
+            s->has_result = true;
+            s->result_cv.notify_all();
+        });
+        slot->pool->set_count(1);
+
+        slots_.push_back(std::move(slot));
+    }
+
+    // slots sharing the global table would all advance its age on every request, racing on
+    // it and aging each other's entries, so it is advanced once for the whole session
+    shared_tt_ = !partition_tt;
+    if (shared_tt_)
+        search::tt.increment();
+
+    for (int i = 0; i < slot_count; ++i)
+        slots_[i]->runner = std::thread(&Server::run_slot, this, i);
+}
+
+Server::~Server() {
+    {
+        std::lock_guard lock(queue_mutex_);
+        closing_ = true;
+    }
+    queue_cv_.notify_all();
+
+    for (auto& slot : slots_)
+        if (slot->runner.joinable())
+            slot->runner.join();
+}
+
+void Server::run(std::istream& in) {
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line == "quit")
+            break;
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+
+        Request request;
+        request.received = Clock::now();
+        if (!parse_request(line, request))
+            continue;
+
+        if (!started_) {
+            first_request_ = request.received;
+            started_ = true;
+        }
+
+        if (!has_legal_moves(request.board)) {
+            report_terminal(request);
+            continue;
+        }
+
+        push(std::move(request), std::numeric_limits<size_t>::max());
+    }
+
+    finish();
+    print_summary();
+}
+
+void Server::analyse(std::istream& in, std::ostream* out, const search::Limits& limits, bool csv) {
+    analysing_ = true;
+    csv_ = csv;
+    out_ = out;
+
+    if (csv_)
+        write("id,fen,bestmove,score_type,score,depth,nodes,pv,time_ms");
+
+    first_request_ = Clock::now();
+    started_ = true;
+
+    // only a few positions per slot are read ahead, files can have millions of them
+    const size_t max_queued = 4 * slots_.size();
+
+    std::string line;
+    uint64_t line_no = 0, seq = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos || line[0] == '#')
+            continue;
+
+        Request request;
+        request.received = Clock::now();
+        request.id = std::to_string(line_no);
+        request.limits = limits;
+        request.limits.minimal = true;
+        request.limits.keep_tt_age = shared_tt_;
+
+        if (!parse_epd(line, request)) {
+            std::lock_guard lock(output_mutex_);
+            skipped_++;
+            println("info string Skipped line {}, invalid fen", line_no);
+            continue;
+        }
+
+        request.seq = seq++;
+
+        // nothing to search, but the position still gets its line
+        if (!has_legal_moves(request.board)) {
+            report_terminal(request);
+            continue;
+        }
+
+        push(std::move(request), max_queued);
+    }
+
+    finish();
+    print_analysis_summary();
+}
+
+void Server::push(Request&& request, size_t max_queued) {
+    {
+        std::unique_lock lock(queue_mutex_);
+        space_cv_.wait(lock, [&] { return queue_.size() < max_queued; });
+        queue_.push_back(std::move(request));
+    }
+    queue_cv_.notify_one();
+}
+
+void Server::finish() {
+    {
+        std::lock_guard lock(queue_mutex_);
+        closing_ = true;
+    }
+    queue_cv_.notify_all();
+
+    for (auto& slot : slots_)
+        if (slot->runner.joinable())
+            slot->runner.join();
+}
+
+// <id> startpos|fen <fen> [moves ...] go depth|nodes|movetime <n>
+bool Server::parse_request(const std::string& line, Request& request) {
+    std::istringstream is(line);
+    is >> request.id;
+
+    std::string rest;
+    std::getline(is, rest);
+
+    auto error = [&](const std::string& msg) {
+        std::lock_guard lock(output_mutex_);
+        println("{{\"id\":{},\"error\":{}}}", json_str(request.id), json_str(msg));
+        return false;
+    };
+
+    const size_t go = rest.find(" go");
+    if (go == std::string::npos)
+        return error("missing go");
+
+    std::istringstream position(rest.substr(0, go));
+    std::string position_error;
+    if (!parse_position(request.board, position, position_error))
+        return error(position_error);
+
+    std::istringstream limits(rest.substr(go + 3));
+    std::string token;
+    while (limits >> token) {
+        if (token == "depth")
+            limits >> request.limits.depth;
+        else if (token == "nodes")
+            limits >> request.limits.nodes;
+        else if (token == "movetime")
+            limits >> request.limits.time.maximum;
+        else
+            return error("unknown limit " + token);
+    }
+
+    // a request without limits would hold its slot forever
+    if (request.limits.depth == search::MAX_PLY - 1 && !request.limits.nodes && !request.limits.time.maximum)
+        return error("no depth, nodes or movetime given");
+
+    request.limits.minimal = true;
+    request.limits.keep_tt_age = shared_tt_;
+    return true;
+}
+
+// <fen> or <epd> [opcodes], the id opcode names the result instead of the line number
+bool Server::parse_epd(const std::string& line, Request& request) {
+    std::istringstream is(line);
+    std::vector<std::string> fields;
+
+    std::string token;
+    for (int i = 0; i < 4 && is >> token; ++i)
+        fields.push_back(token);
+    if (fields.size() != 4)
+        return false;
+
+    // epd has no move counters, a fen has both
+    const auto pos = is.tellg();
+    std::string half_moves, full_moves;
+    if (is >> half_moves >> full_moves && is_number(half_moves) && is_number(full_moves)) {
+        fields.push_back(half_moves);
+        fields.push_back(full_moves);
+    } else {
+        fields.push_back("0");
+        fields.push_back("1");
+        is.clear();
+        is.seekg(pos);
+    }
+
+    std::string opcodes;
+    std::getline(is, opcodes);
+    for (size_t at = opcodes.find("id \""); at != std::string::npos; at = opcodes.find("id \"", at + 1)) {
+        if (at && opcodes[at - 1] != ' ' && opcodes[at - 1] != ';')
+            continue;
+
+        const size_t end = opcodes.find('"', at + 4);
+        if (end != std::string::npos)
+            request.id = opcodes.substr(at + 4, end - at - 4);
+        break;
+    }
+
+    for (const auto& field : fields)
+        request.fen += (request.fen.empty() ? "" : " ") + field;
+
+    if (!valid_fen(request.fen))
+        return false;
+
+    request.board.set_fen(request.fen);
+    return true;
+}
+
+void Server::run_slot(int idx) {
+    Slot& slot = *slots_[idx];
+
+    while (true) {
+        Request request;
+        {
+            std::unique_lock lock(queue_mutex_);
+            queue_cv_.wait(lock, [this] { return closing_ || !queue_.empty(); });
+            if (queue_.empty())
+                return;
+
+            request = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        space_cv_.notify_one();
+
+        {
+            std::lock_guard lock(slot.result_mutex);
+            slot.has_result = false;
+        }
+
+        const auto search_start = Clock::now();
+        slot.pool->launch_workers(request.board, request.limits);
+        slot.pool->wait();
+
+        report(idx, request, search_start);
+    }
+}
+
+void Server::report(int idx, const Request& request, Clock::time_point search_start) {
+    Slot& slot = *slots_[idx];
+
+    Move best_move, ponder_move;
+    {
+        std::unique_lock lock(slot.result_mutex);
+        slot.result_cv.wait(lock, [&] { return slot.has_result; });
+        best_move = slot.best_move;
+        ponder_move = slot.ponder_move;
+    }
+
+    const auto now = Clock::now();
+    const int64_t latency_us = std::chrono::duration_cast<std::chrono::microseconds>(now - request.received).count();
+    const int64_t search_us = std::chrono::duration_cast<std::chrono::microseconds>(now - search_start).count();
+
+    const search::Search* search = slot.pool->main_thread();
+    const auto& rm = search->best_root_move();
+
+    const bool mate = std::abs(rm.score) >= search::SCORE_MATE_IN_MAX_PLY;
+    const int score = mate ? (search::SCORE_MATE - std::abs(rm.score) + 1) / 2 * (rm.score > 0 ? 1 : -1)
+                           : search->normalize_score(rm.score);
+
+    std::string pv = std::format("{}", static_cast<const Move&>(rm));
+    for (int i = 1; i < rm.pv.length && rm.pv(i); ++i)
+        pv += std::format(" {}", rm.pv(i));
+
+    std::lock_guard lock(output_mutex_);
+    latencies_us_.push_back(latency_us);
+
+    if (analysing_) {
+        total_nodes_ += slot.pool->total_nodes();
+        write_ordered(
+            request.seq,
+            result_line(request, best_move, mate, score, search->completed_depth(), slot.pool->total_nodes(), pv, search_us)
+        );
+        return;
+    }
+
+    println(
+        "{{\"id\":{},\"slot\":{},\"bestmove\":\"{}\",\"ponder\":{},\"score\":{{\"{}\":{}}},\"depth\":{},\"nodes\":{},"
+        "\"pv\":\"{}\",\"search_ms\":{:.3f},\"latency_ms\":{:.3f}}}",
+        json_str(request.id),
+        idx,
+        best_move,
+        ponder_move ? std::format("\"{}\"", ponder_move) : "null",
+        mate ? "mate" : "cp",
+        score,
+        search->completed_depth(),
+        slot.pool->total_nodes(),
+        pv,
+        search_us / 1000.0,
+        latency_us / 1000.0
+    );
+}
+
+// mate or stalemate, answered without a search since there is no root move to report
+void Server::report_terminal(const Request& request) {
+    const bool mate = request.board.in_check();
+    const int64_t latency_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - request.received).count();
+
+    std::lock_guard lock(output_mutex_);
+    latencies_us_.push_back(latency_us);
+
+    if (analysing_) {
+        write_ordered(request.seq, result_line(request, Move::none(), mate, 0, 0, 0, "", 0));
+        return;
+    }
+
+    println(
+        "{{\"id\":{},\"slot\":null,\"bestmove\":\"none\",\"ponder\":null,\"score\":{{\"{}\":0}},\"depth\":0,"
+        "\"nodes\":0,\"pv\":\"\",\"search_ms\":0.000,\"latency_ms\":{:.3f}}}",
+        json_str(request.id),
+        mate ? "mate" : "cp",
+        latency_us / 1000.0
+    );
+}
+
+std::string Server::result_line(
+    const Request& request, Move best_move, bool mate, int score, int depth, uint64_t nodes, const std::string& pv,
+    int64_t search_us
+) const {
+    if (csv_) {
+        return std::format(
+            "{},{},{},{},{},{},{},{},{:.3f}",
+            csv_str(request.id),
+            request.fen,
+            best_move,
+            mate ? "mate" : "cp",
+            score,
+            depth,
+            nodes,
+            pv,
+            search_us / 1000.0
+        );
+    }
+
+    return std::format(
+        "{{\"id\":{},\"fen\":\"{}\",\"bestmove\":\"{}\",\"score\":{{\"{}\":{}}},\"depth\":{},\"nodes\":{},"
+        "\"pv\":\"{}\",\"time_ms\":{:.3f}}}",
+        json_str(request.id),
+        request.fen,
+        best_move,
+        mate ? "mate" : "cp",
+        score,
+        depth,
+        nodes,
+        pv,
+        search_us / 1000.0
+    );
+}
+
+// results finish out of order, a line is held back until all before it are written
+void Server::write_ordered(uint64_t seq, std::string&& line) {
+    finished_.emplace(seq, std::move(line));
+
+    for (auto it = finished_.begin(); it != finished_.end() && it->first == next_seq_; it = finished_.erase(it)) {
+        write(it->second);
+        next_seq_++;
+    }
+}
+
+void Server::write(const std::string& line) {
+    if (out_)
+        *out_ << line << '\n';
+    else
+        println("{}", line);
+}
+
+void Server::print_summary() {
+    std::lock_guard lock(output_mutex_);
+    if (latencies_us_.empty())
+        return;
+
+    std::vector<int64_t> sorted = latencies_us_;
+    std::ranges::sort(sorted);
+
+    int64_t sum = 0;
+    for (int64_t us : sorted)
+        sum += us;
+
+    const int64_t elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - first_request_).count();
+
+    println(
+        "info string Server answered {} requests in {} ms, {:.1f} per second, latency avg {:.2f} ms p50 {:.2f} ms "
+        "p99 {:.2f} ms max {:.2f} ms",
+        sorted.size(),
+        elapsed_us / 1000,
+        sorted.size() * 1e6 / std::max<int64_t>(1, elapsed_us),
+        sum / 1000.0 / sorted.size(),
+        percentile(sorted, 0.5),
+        percentile(sorted, 0.99),
+        sorted.back() / 1000.0
+    );
+}
+
+void Server::print_analysis_summary() {
+    std::lock_guard lock(output_mutex_);
+    if (out_)
+        out_->flush();
+
+    const int64_t elapsed_us =
+        std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - first_request_).count());
+
+    println(
+        "info string Analysed {} positions in {} ms with {} searches, {:.1f} positions per second, {} nodes, {} nps, "
+        "{} skipped",
+        latencies_us_.size(),
+        elapsed_us / 1000,
+        slots_.size(),
+        latencies_us_.size() * 1e6 / elapsed_us,
+        total_nodes_,
+        total_nodes_ * 1000000 / elapsed_us,
+        skipped_
+    );
+}
+
+} // namespace astra::uci
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <istream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../search/threads.h"
+
+namespace astra::uci {
+
+// answers independent search requests side by side. every slot is a single threaded
+// pool with its own board, limits and search state, they only share the nnue weights
+// and, unless partitioned, the hash table
+class Server {
+    using Clock = std::chrono::steady_clock;
+
+  public:
+    Server(int slot_count, uint64_t hash_mb, bool partition_tt);
+    ~Server();
+
+    // reads requests until quit or the end of the input, then waits for the pending ones
+    void run(std::istream& in);
+
+    // searches every fen or epd line of the input with the same limits and writes the
+    // results in input order, as csv or json lines, to out or stdout if it's null
+    void analyse(std::istream& in, std::ostream* out, const search::Limits& limits, bool csv);
+
+  private:
+    struct Request {
+        std::string id;
+        uint64_t seq = 0;
+        std::string fen;
+        Board board;
+        search::Limits limits;
+        Clock::time_point received;
+    };
+
+    struct Slot {
+        std::unique_ptr<search::TTable> tt;
+        std::unique_ptr<search::ThreadPool> pool;
+        std::thread runner;
+
+        // filled by the bestmove handler, which might run on the watchdog thread
+        std::mutex result_mutex;
+        std::condition_variable result_cv;
+        bool has_result = false;
+        Move best_move;
+        Move ponder_move;
+    };
+
+    std::vector<std::unique_ptr<Slot>> slots_;
+    bool shared_tt_ = false;
+
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::condition_variable space_cv_;
+    std::deque<Request> queue_;
+    bool closing_ = false;
+
+    // written by every runner, so lines and statistics are kept under one lock
+    std::mutex output_mutex_;
+    std::vector<int64_t> latencies_us_;
+    Clock::time_point first_request_;
+    bool started_ = false;
+
+    // analysis results wait here until the ones before them are written
+    bool analysing_ = false;
+    bool csv_ = false;
+    std::ostream* out_ = nullptr;
+    std::map<uint64_t, std::string> finished_;
+    uint64_t next_seq_ = 0;
+    uint64_t total_nodes_ = 0;
+    uint64_t skipped_ = 0;
+
+    bool parse_request(const std::string& line, Request& request);
+    bool parse_epd(const std::string& line, Request& request);
+    void push(Request&& request, size_t max_queued);
+    void finish();
+    void run_slot(int idx);
+    void report(int idx, const Request& request, Clock::time_point search_start);
+    void report_terminal(const Request& request);
+    std::string result_line(
+        const Request& request, Move best_move, bool mate, int score, int depth, uint64_t nodes, const std::string& pv,
+        int64_t search_us
+    ) const;
+    void write_ordered(uint64_t seq, std::string&& line);
+    void write(const std::string& line);
+    void print_summary();
+    void print_analysis_summary();
+};
+
+} // namespace astra::uci
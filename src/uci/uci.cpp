@@ -1,12 +1,19 @@
+#include <algorithm>
 #include <chrono>
+#include <cstdlib>
+#include <fstream>
 #include <sstream>
+#include <string_view>
+#include <thread>
 
 #include "../../third_party/fathom/tbprobe.h"
+#include "../chess/movegen.h"
 #include "../chess/perft.h"
 #include "../nnue/nnue.h"
 #include "../search/threads.h"
 #include "../search/tune_params.h"
 #include "../util.h"
+#include "server.h"
 #include "uci.h"
 
 namespace astra::uci {
@@ -65,15 +72,37 @@ UCI::UCI() {
 
     options_.add("SyzygyPath", {OptionType::STRING});
     options_.add("Minimal", {OptionType::CHECK, "false"});
+    options_.add("TTStats", {OptionType::CHECK, "false"});
+    options_.add("ETC", {OptionType::CHECK, "false"});
     options_.add("MoveOverhead", {OptionType::SPIN, "10", 1, 10000});
+    options_.add("BestmoveLatency", {OptionType::SPIN, "10", 1, 10000});
+    options_.add("NodesTime", {OptionType::SPIN, "0", 0, 100000});
+    options_.add("LoadAware", {OptionType::CHECK, "false"});
+    options_.add("BaselineKnps", {OptionType::SPIN, "0", 0, 1000000000});
     options_.add("MultiPV", {OptionType::SPIN, "1", 1, 218});
+    options_.add("Ponder", {OptionType::CHECK, "false"});
     options_.add("Threads", {OptionType::SPIN, "1", 1, 1024});
+    options_.add("Breadcrumbs", {OptionType::CHECK, "false"});
+    options_.add("ShareHistory", {OptionType::CHECK, "false"});
+    options_.add("ThreadBinding", {OptionType::STRING, "none"});
+    options_.add("SpinWait", {OptionType::SPIN, "0", 0, 60000});
+    options_.add("NumaPolicy", {OptionType::STRING, "none"});
+    options_.add("HashFile", {OptionType::STRING});
+    options_.add("HashShm", {OptionType::STRING});
     options_.add("Hash", {OptionType::SPIN, "16", 1, 256 * 1024});
+    options_.add("LocalHash", {OptionType::SPIN, "0", 0, 64 * 1024});
+    options_.add("LocalHashDepth", {OptionType::SPIN, "1", 0, 8});
+    options_.add("LocalHashPromote", {OptionType::CHECK, "true"});
 }
 
 void UCI::loop(int argc, char** argv) {
     if (argc >= 2 && std::string(argv[1]) == "bench") {
-        bench();
+        bench(argc >= 3 ? std::stoi(argv[2]) : 13);
+        return;
+    }
+
+    if (argc >= 2 && std::string(argv[1]) == "server") {
+        server(argc >= 3 ? std::stoi(argv[2]) : 0, argc >= 4 && std::string(argv[3]) == "partition");
         return;
     }
 
@@ -89,6 +118,8 @@ void UCI::loop(int argc, char** argv) {
             options_.print();
             println("uciok");
         } else if (token == "isready") {
+            search::tt.wait_cleared(true);
+            search::thread_pool.wait_cleared();
             println("readyok");
         } else if (token == "ucinewgame") {
             new_game();
@@ -103,7 +134,20 @@ void UCI::loop(int argc, char** argv) {
             else
                 perft(board_, depth);
         } else if (token == "bench") {
-            bench();
+            int depth = 13;
+            is >> depth;
+            bench(depth);
+        } else if (token == "smpbench") {
+            int depth = 11;
+            is >> depth;
+
+            std::vector<int> thread_counts;
+            for (int n; is >> n;)
+                thread_counts.push_back(n);
+            if (thread_counts.empty())
+                thread_counts = {1, 8, 32, 128};
+
+            smp_bench(depth, thread_counts);
         } else if (token == "eval") {
             nnue::AccumulatorList accum_list;
             accum_list.reset(board_);
@@ -121,10 +165,48 @@ void UCI::loop(int argc, char** argv) {
                     0.002
                 );
             }
+        } else if (token == "latency") {
+            int iterations = 20;
+            is >> iterations;
+            latency(iterations);
+        } else if (token == "ttstats") {
+            search::thread_pool.tt_stats().print(search::tt.hashfull(true));
+        } else if (token == "ttbench") {
+            uint64_t size_mb = 16, probes = 50000000;
+            is >> size_mb >> probes;
+            search::tt_bench(size_mb, probes);
+        } else if (token == "savehash" || token == "loadhash") {
+            std::string path;
+            std::getline(is >> std::ws, path);
+
+            search::thread_pool.stop();
+            search::thread_pool.wait();
+
+            if (path.empty())
+                println("No file provided for {}", token);
+            else if (token == "savehash")
+                println("info string {} hash file {}", search::tt.save(path) ? "Saved" : "Failed to save", path);
+            else if (search::tt.load(path))
+                println("info string Loaded hash file {} ({} MB)", path, search::tt.size_mb());
+            else
+                println("info string Failed to load hash file {}", path);
         } else if (token == "setoption") {
             options_.set(is.str());
         } else if (token == "d") {
             board_.print();
+        } else if (token == "ponderhit") {
+            search::thread_pool.ponderhit();
+        } else if (token == "server") {
+            int slots = 0;
+            std::string tt_mode;
+            is >> slots >> tt_mode;
+
+            // requests are read until quit, which also ends the engine
+            server(slots, tt_mode == "partition");
+            tb_free();
+            break;
+        } else if (token == "analyse") {
+            analyse(is);
         } else if (token == "stop") {
             search::thread_pool.stop();
             search::thread_pool.wait();
@@ -139,8 +221,12 @@ void UCI::loop(int argc, char** argv) {
     }
 }
 
-void UCI::update_position(std::istringstream& is) {
-    std::string token, fen;
+namespace {
+
+// splits the arguments of a position command into the fen and the moves after it,
+// callers report the errors, the server answers them in its json instead of printing
+bool read_position(std::istringstream& is, std::string& fen, std::vector<std::string>& moves) {
+    std::string token;
 
     is >> token;
     if (token == "startpos") {
@@ -149,26 +235,215 @@ void UCI::update_position(std::istringstream& is) {
         while (is >> token && token != "moves")
             fen += token + " ";
     } else {
-        println("Unknown command: {}", token);
+        return false;
+    }
+
+    while (is >> token)
+        if (token != "moves")
+            moves.push_back(token);
+
+    return true;
+}
+
+bool apply_move(Board& board, const std::string& str_move) {
+    const Move move = parse_move(board, str_move);
+    if (!move)
+        return false;
+
+    board.make_move(move);
+    // if half move clock resets, then we can reset the history
+    // since the last positions should not be considered in the repetition
+    if (!board.fifty_move_count())
+        board.reset_ply();
+
+    return true;
+}
+
+Square parse_square(char file, char rank) {
+    if (file < 'a' || file > 'h' || rank < '1' || rank > '8')
+        return NO_SQUARE;
+    return make_square(static_cast<Rank>(rank - '1'), static_cast<File>(file - 'a'));
+}
+
+} // namespace
+
+// an overlong rank would make set_fen write past the board, a missing king or a side not
+// to move in check would break the search, and castling needs its king and rook at home
+bool valid_fen(const std::string& fen) {
+    std::istringstream is(fen);
+    std::vector<std::string> fields;
+    for (std::string field; is >> field;)
+        fields.push_back(field);
+    if (fields.size() != 6)
+        return false;
+
+    NDArray<char, NUM_SQUARES> squares;
+    squares.fill(' ');
+
+    int rank = 7, file = 0;
+    for (char c : fields[0]) {
+        if (c == '/') {
+            if (file != 8 || rank == 0)
+                return false;
+            rank--;
+            file = 0;
+        } else if (c >= '1' && c <= '8') {
+            file += c - '0';
+            if (file > 8)
+                return false;
+        } else if (std::string_view("pnbrqkPNBRQK").find(c) != std::string_view::npos) {
+            if (file >= 8)
+                return false;
+            squares(rank * 8 + file++) = c;
+        } else {
+            return false;
+        }
+    }
+    if (rank != 0 || file != 8)
+        return false;
+
+    if (std::ranges::count(squares, 'K') != 1 || std::ranges::count(squares, 'k') != 1)
+        return false;
+    for (int f = 0; f < 8; ++f)
+        if (squares(f) == 'P' || squares(f) == 'p' || squares(56 + f) == 'P' || squares(56 + f) == 'p')
+            return false;
+
+    const std::string& stm = fields[1];
+    if (stm != "w" && stm != "b")
+        return false;
+
+    const std::string& castling = fields[2];
+    if (castling != "-") {
+        for (size_t i = 0; i < castling.size(); ++i) {
+            const char c = castling[i];
+            if (castling.find(c, i + 1) != std::string::npos)
+                return false;
+
+            const bool ok = (c == 'K' && squares(SQ_E1) == 'K' && squares(SQ_H1) == 'R')
+                            || (c == 'Q' && squares(SQ_E1) == 'K' && squares(SQ_A1) == 'R')
+                            || (c == 'k' && squares(SQ_E8) == 'k' && squares(SQ_H8) == 'r')
+                            || (c == 'q' && squares(SQ_E8) == 'k' && squares(SQ_A8) == 'r');
+            if (!ok)
+                return false;
+        }
+    }
+
+    const std::string& ep = fields[3];
+    if (ep != "-" && (ep.size() != 2 || ep[0] < 'a' || ep[0] > 'h' || ep[1] != (stm == "w" ? '6' : '3')))
+        return false;
+
+    for (int i = 4; i < 6; ++i)
+        if (fields[i].empty() || fields[i].size() > 4
+            || !std::ranges::all_of(fields[i], [](char c) { return c >= '0' && c <= '9'; }))
+            return false;
+
+    // the side to move could capture the king
+    const Board board(fen);
+    const Color us = board.side_to_move();
+    return !board.attackers_to(us, board.king_sq(~us), board.occupancy());
+}
+
+bool parse_position(Board& board, std::istringstream& is, std::string& error) {
+    std::string fen;
+    std::vector<std::string> moves;
+    if (!read_position(is, fen, moves)) {
+        error = "invalid position";
+        return false;
+    }
+
+    if (!valid_fen(fen)) {
+        error = "invalid fen";
+        return false;
+    }
+
+    board.set_fen(fen);
+    for (const auto& str_move : moves) {
+        if (!apply_move(board, str_move)) {
+            error = "illegal move " + str_move;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// builds the move from its squares and checks it against the board instead of
+// generating every legal move and formatting each one for the comparison
+Move parse_move(const Board& board, const std::string& str_move) {
+    if (str_move.size() != 4 && str_move.size() != 5)
+        return Move::none();
+
+    const Square from = parse_square(str_move[0], str_move[1]);
+    const Square to = parse_square(str_move[2], str_move[3]);
+    if (from == NO_SQUARE || to == NO_SQUARE)
+        return Move::none();
+
+    const Piece pc = board.piece_at(from);
+    if (!is_valid(pc))
+        return Move::none();
+
+    const PieceType pt = type_of(pc);
+    const bool capture = is_valid(board.piece_at(to));
+
+    MoveType mt = capture ? CAPTURE : QUIET;
+    if (str_move.size() == 5) {
+        const size_t prom = std::string_view("nbrq").find(str_move[4]);
+        if (prom == std::string_view::npos)
+            return Move::none();
+        mt = static_cast<MoveType>((capture ? PC_KNIGHT : PQ_KNIGHT) + prom);
+    } else if (pt == KING && std::abs(file_of(from) - file_of(to)) == 2) {
+        mt = CASTLING;
+    } else if (pt == PAWN && to == board.en_passant() && !capture) {
+        mt = EN_PASSANT;
+    }
+
+    const Move move(from, to, mt);
+    if (!board.is_pseudo_legal(move) || !board.is_legal(move))
+        return Move::none();
+
+    return move;
+}
+
+// a gui sends the whole game before every go, when the command only adds moves to
+// the last one, those are played on the current board instead of replaying the game
+void UCI::update_position(std::istringstream& is) {
+    std::string fen;
+    std::vector<std::string> moves;
+    if (!read_position(is, fen, moves)) {
+        println("info string Invalid position command");
         return;
     }
 
-    board_.set_fen(fen);
-    while (is >> token) {
-        if (token == "moves")
-            continue;
-        board_.make_move(parse_move(token));
-        // if half move clock resets, then we can reset the history
-        // since the last positions should not be considered in the repetition
-        if (!board_.fifty_move_count())
-            board_.reset_ply();
+    if (!valid_fen(fen)) {
+        println("info string Invalid fen {}", fen);
+        return;
+    }
+
+    const bool extends = fen == position_fen_ && moves.size() >= position_moves_.size()
+                         && std::equal(position_moves_.begin(), position_moves_.end(), moves.begin());
+
+    if (!extends) {
+        board_.set_fen(fen);
+        position_fen_ = fen;
+        position_moves_.clear();
+    }
+
+    for (size_t i = position_moves_.size(); i < moves.size(); i++) {
+        if (!apply_move(board_, moves[i])) {
+            println("info string Illegal move {}", moves[i]);
+            break;
+        }
+        position_moves_.push_back(moves[i]);
     }
 }
 
 void UCI::new_game() {
-    search::tt.clear();
     search::thread_pool.stop();
     search::thread_pool.wait();
+
+    available_nodes_ = -1;
+    nodes_time_search_ = false;
+
     search::thread_pool.new_game();
 }
 
@@ -195,6 +470,8 @@ void UCI::go(std::istringstream& is) {
             is >> b_inc;
         } else if (token == "movestogo") {
             is >> moves_to_go;
+        } else if (token == "ponder") {
+            limits.ponder = true;
         } else if (token == "movetime") {
             is >> limits.time.maximum;
         } else if (token == "depth") {
@@ -210,35 +487,241 @@ void UCI::go(std::istringstream& is) {
     Color stm = board_.side_to_move();
     int64_t time_left = (stm == WHITE) ? w_time : b_time;
 
+    const int64_t nodes_per_ms = std::stoi(options_.get("NodesTime"));
+
+    // charge the previous search to the node clock
+    if (nodes_time_search_) {
+        search::thread_pool.stop();
+        search::thread_pool.wait();
+
+        const int64_t used = search::thread_pool.clock_nodes();
+        available_nodes_ = std::max(nodes_per_ms, available_nodes_ + nodes_time_inc_ - used);
+        nodes_time_search_ = false;
+    }
+
     if (time_left != 0) {
-        int inc = (stm == WHITE) ? w_inc : b_inc;
-        limits.time = search::TimeMan::get_optimum(
-            time_left, inc, std::max(moves_to_go, 0), std::stoi(options_.get("MoveOverhead"))
-        );
+        int64_t inc = (stm == WHITE) ? w_inc : b_inc;
+        int64_t overhead = std::stoi(options_.get("MoveOverhead"));
+
+        // the gui clock only initializes the node clock, from then on it is ignored
+        if (nodes_per_ms) {
+            if (available_nodes_ < 0)
+                available_nodes_ = nodes_per_ms * time_left;
+
+            time_left = available_nodes_;
+            inc *= nodes_per_ms;
+            overhead *= nodes_per_ms;
+
+            limits.nodes_time = true;
+            nodes_time_inc_ = inc;
+            nodes_time_search_ = true;
+        }
+
+        limits.time = search::TimeMan::get_optimum(time_left, inc, std::max(moves_to_go, 0), overhead);
     }
 
     limits.multipv = std::stoi(options_.get("MultiPV"));
     limits.minimal = (options_.get("Minimal") == "true");
+    limits.tt_stats = (options_.get("TTStats") == "true");
+    limits.etc = (options_.get("ETC") == "true");
+    limits.local_tt_depth = std::stoi(options_.get("LocalHashDepth"));
+    limits.local_tt_promote = (options_.get("LocalHashPromote") == "true");
+    limits.load_aware = (options_.get("LoadAware") == "true");
+    limits.breadcrumbs = (options_.get("Breadcrumbs") == "true") && search::thread_pool.size() > 1;
+    limits.baseline_nps = std::stoull(options_.get("BaselineKnps")) * 1000;
 
     // start search
     search::thread_pool.launch_workers(board_, limits);
 }
 
-void UCI::bench() {
+void UCI::server(int slots, bool partition_tt) {
+    search::thread_pool.stop();
+    search::thread_pool.wait();
+
+    if (slots <= 0)
+        slots = std::max(1u, std::thread::hardware_concurrency());
+
+    const uint64_t hash_mb = std::stoi(options_.get("Hash"));
+
+    // with partitioned tables the global one isn't used anymore, so its memory goes to the slots
+    if (partition_tt)
+        search::tt.init(1);
+
+    Server server(slots, hash_mb, partition_tt);
+    println(
+        "info string Server ready with {} slots and {}",
+        slots,
+        partition_tt ? std::format("a {} MB hash each", std::max<uint64_t>(1, hash_mb / slots))
+                     : std::format("one shared {} MB hash", search::tt.size_mb())
+    );
+
+    server.run(std::cin);
+}
+
+// analyse <file> [depth|nodes|movetime <n>] [threads <n>] [csv|jsonl] [out <file>] [partition]
+void UCI::analyse(std::istringstream& is) {
+    std::string path, out_path, token;
+    is >> path;
+
+    search::Limits limits;
+    int threads = std::stoi(options_.get("Threads"));
+    bool csv = false, partition_tt = false;
+
+    while (is >> token) {
+        if (token == "depth") {
+            is >> limits.depth;
+        } else if (token == "nodes") {
+            is >> limits.nodes;
+        } else if (token == "movetime") {
+            is >> limits.time.maximum;
+        } else if (token == "threads") {
+            is >> threads;
+        } else if (token == "csv" || token == "jsonl") {
+            csv = (token == "csv");
+        } else if (token == "out") {
+            is >> out_path;
+        } else if (token == "partition") {
+            partition_tt = true;
+        } else {
+            println("Unknown command: {}", token);
+            return;
+        }
+    }
+
+    if (limits.depth == search::MAX_PLY - 1 && !limits.nodes && !limits.time.maximum) {
+        println("info string No depth, nodes or movetime given for analyse");
+        return;
+    }
+
+    std::ifstream in(path);
+    if (!in) {
+        println("info string Failed to open {}", path);
+        return;
+    }
+
+    std::ofstream out;
+    if (!out_path.empty()) {
+        out.open(out_path);
+        if (!out) {
+            println("info string Failed to open {}", out_path);
+            return;
+        }
+    }
+
+    search::thread_pool.stop();
+    search::thread_pool.wait();
+
+    threads = std::max(1, threads);
+    const uint64_t hash_mb = std::stoi(options_.get("Hash"));
+
+    // the global table lends its memory to the partitions and gets it back afterwards
+    if (partition_tt)
+        search::tt.init(1);
+
+    {
+        Server server(threads, hash_mb, partition_tt);
+        println(
+            "info string Analysing {} with {} searches and {}",
+            path,
+            threads,
+            partition_tt ? std::format("a {} MB hash each", std::max<uint64_t>(1, hash_mb / threads))
+                         : std::format("one shared {} MB hash", search::tt.size_mb())
+        );
+
+        server.analyse(in, out_path.empty() ? nullptr : &out, limits, csv);
+    }
+
+    if (partition_tt)
+        search::tt.init(hash_mb);
+}
+
+// measures how long it takes from go until every thread searches, and from stop until bestmove
+void UCI::latency(int iterations) {
+    using Clock = std::chrono::steady_clock;
+
+    search::thread_pool.stop();
+    search::thread_pool.wait();
+
+    // the search would end right away and never have every thread searching
+    MoveList<Move> moves;
+    gen_moves<GenType::LEGAL>(moves, board_);
+    if (!moves.size()) {
+        println("info string No legal moves in this position, latency needs one to search");
+        return;
+    }
+
+    search::Limits limits;
+    limits.minimal = true;
+
+    int64_t start_sum = 0, start_max = 0, stop_sum = 0, stop_max = 0;
+
+    // the measured searches are not real answers, so their bestmoves are not printed
+    search::thread_pool.set_bestmove_handler([](Move, Move) {});
+
+    for (int i = 0; i < iterations; ++i) {
+        const auto go_time = Clock::now();
+        search::thread_pool.launch_workers(board_, limits);
+
+        const auto give_up = go_time + std::chrono::seconds(1);
+        while (!search::thread_pool.all_searching() && !search::thread_pool.bestmove_sent() && Clock::now() < give_up)
+            std::this_thread::yield();
+
+        if (!search::thread_pool.all_searching()) {
+            search::thread_pool.stop();
+            search::thread_pool.wait();
+            search::thread_pool.set_bestmove_handler(nullptr);
+            println("info string Search ended or stalled before every thread started, latency aborted");
+            return;
+        }
+
+        const auto started_time = Clock::now();
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+        const auto stop_time = Clock::now();
+        search::thread_pool.stop();
+        while (!search::thread_pool.bestmove_sent())
+            std::this_thread::yield();
+        const auto bestmove_time = Clock::now();
+
+        search::thread_pool.wait();
+
+        const int64_t start_us =
+            std::chrono::duration_cast<std::chrono::microseconds>(started_time - go_time).count();
+        const int64_t stop_us =
+            std::chrono::duration_cast<std::chrono::microseconds>(bestmove_time - stop_time).count();
+
+        start_sum += start_us;
+        stop_sum += stop_us;
+        start_max = std::max(start_max, start_us);
+        stop_max = std::max(stop_max, stop_us);
+    }
+
+    search::thread_pool.set_bestmove_handler(nullptr);
+
+    println(
+        "info string go to first node avg {} us max {} us, stop to bestmove avg {} us max {} us",
+        start_sum / std::max(iterations, 1),
+        start_max,
+        stop_sum / std::max(iterations, 1),
+        stop_max
+    );
+}
+
+uint64_t UCI::run_bench(int depth) {
     new_game();
     uint64_t nodes = 0;
 
     std::string minimal_val = options_.get("Minimal");
     options_.get("Minimal").set("true");
 
-    auto start = std::chrono::high_resolution_clock::now();
     for (const auto& pos : bench_positions) {
         println("\nfen: {}", pos);
 
         std::istringstream iss("fen " + pos);
         update_position(iss);
         iss.clear();
-        iss.str("depth 13");
+        iss.str("depth " + std::to_string(depth));
         go(iss);
 
         search::thread_pool.wait();
@@ -249,21 +732,53 @@ void UCI::bench() {
     search::thread_pool.stop();
     options_.get("Minimal").set(minimal_val);
 
+    return nodes;
+}
+
+void UCI::bench(int depth) {
+    auto start = std::chrono::high_resolution_clock::now();
+    const uint64_t nodes = run_bench(depth);
     auto end = std::chrono::high_resolution_clock::now();
     auto total_time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 
-    println("\n{} nodes {} nps", nodes, nodes * 1000 / total_time);
+    println("\n{} nodes {} nps {} ms", nodes, nodes * 1000 / std::max<int64_t>(1, total_time), total_time);
 }
 
-Move UCI::parse_move(const std::string& str_move) const {
-    MoveList<Move> ml;
-    gen_moves<GenType::LEGAL>(ml, board_);
+// time to depth over the bench positions for each thread count, the speedup is relative to the first count
+void UCI::smp_bench(int depth, const std::vector<int>& thread_counts) {
+    const std::string threads_val = options_.get("Threads");
+
+    struct Result {
+        int threads;
+        uint64_t nodes;
+        int64_t ms;
+    };
+    std::vector<Result> results;
+
+    for (int threads : thread_counts) {
+        options_.set("setoption name Threads value " + std::to_string(threads));
 
-    for (const auto& move : ml)
-        if (std::format("{}", move) == str_move)
-            return move;
+        auto start = std::chrono::high_resolution_clock::now();
+        const uint64_t nodes = run_bench(depth);
+        auto end = std::chrono::high_resolution_clock::now();
 
-    return Move::none();
+        results.push_back({threads, nodes, std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()});
+    }
+
+    options_.set("setoption name Threads value " + threads_val);
+
+    println("");
+    for (const auto& r : results) {
+        println(
+            "info string SMP bench depth {} threads {} time {} ms nodes {} nps {} speedup {:.2f}",
+            depth,
+            r.threads,
+            r.ms,
+            r.nodes,
+            r.nodes * 1000 / std::max<int64_t>(1, r.ms),
+            static_cast<double>(results[0].ms) / std::max<int64_t>(1, r.ms)
+        );
+    }
 }
 
 } // namespace astra::uci
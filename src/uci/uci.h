@@ -2,6 +2,7 @@
 
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "../search/search.h"
 #include "options.h"
@@ -10,6 +11,13 @@ namespace astra::uci {
 
 const std::string STARTING_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 
+// set_fen trusts its input, anything coming from outside is checked with this first
+bool valid_fen(const std::string& fen);
+
+// sets up the board from the arguments of a position command, error says what was wrong
+bool parse_position(Board& board, std::istringstream& is, std::string& error);
+Move parse_move(const Board& board, const std::string& str_move);
+
 class UCI {
   public:
     UCI();
@@ -20,12 +28,24 @@ class UCI {
     Options options_;
     Board board_{STARTING_FEN};
 
+    // the position command board_ was set up from, to only play the new moves of the next one
+    std::string position_fen_;
+    std::vector<std::string> position_moves_;
+
+    // with NodesTime the clock is kept in nodes by the engine itself
+    int64_t available_nodes_ = -1;
+    int64_t nodes_time_inc_ = 0;
+    bool nodes_time_search_ = false;
+
     void update_position(std::istringstream& is);
     void new_game();
     void go(std::istringstream& is);
-    void bench();
-
-    Move parse_move(const std::string& str_move) const;
+    uint64_t run_bench(int depth);
+    void bench(int depth = 13);
+    void smp_bench(int depth, const std::vector<int>& thread_counts);
+    void latency(int iterations);
+    void server(int slots, bool partition_tt);
+    void analyse(std::istringstream& is);
 };
 
 } // namespace astra::uci
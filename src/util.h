@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <format>
+#include <iterator>
 #include <iostream>
 #include <string>
 #include <string_view>
@@ -13,6 +14,7 @@
 #endif
 
 #include "chess/types.h"
+#include "output.h"
 
 template <>
 struct std::formatter<astra::Square> : std::formatter<std::string_view> {
@@ -50,15 +52,32 @@ struct std::formatter<astra::Move> : std::formatter<std::string> {
 
 namespace astra {
 
+// every thread builds its line here, it is handed to the output thread once it ends
+// with a newline
+inline std::string& line_buffer() {
+    thread_local std::string buffer;
+    return buffer;
+}
+
 template <typename... Args>
 void print(std::format_string<Args...> fmt, Args&&... args) {
-    std::cout << std::format(fmt, std::forward<Args>(args)...);
+    std::string& buffer = line_buffer();
+    std::format_to(std::back_inserter(buffer), fmt, std::forward<Args>(args)...);
+
+    if (buffer.ends_with('\n')) {
+        write_line(buffer);
+        buffer.clear();
+    }
 }
 
 template <typename... Args>
 void println(std::format_string<Args...> fmt, Args&&... args) {
-    print(fmt, std::forward<Args>(args)...);
-    std::cout << '\n' << std::flush;
+    std::string& buffer = line_buffer();
+    std::format_to(std::back_inserter(buffer), fmt, std::forward<Args>(args)...);
+    buffer += '\n';
+
+    write_line(buffer);
+    buffer.clear();
 }
 
 inline void print_bb(const Bitboard b) {